@@ -1,6 +1,7 @@
 # On windows, a shared object is a .dll
 win32: SONAME=dll
 else:  SONAME=so
+zconf_static: SONAME=a
 
 # This function sets up the dependencies for libraries that are built with
 # this project.  Specify the libraries you need to depend on in the variable
@@ -20,10 +20,12 @@
 #ifndef ZCONFBROWSERWIDGET_H
 #define ZCONFBROWSERWIDGET_H
 
-#include <QTreeWidget>
+#include <QTreeView>
+
+#include "qtzeroconf/zconfglobal.h"
 
 class ZConfBrowserWidgetPrivate;
-class ZConfBrowserWidget : public QTreeWidget
+class ZCONF_EXPORT ZConfBrowserWidget : public QTreeView
 {
     Q_OBJECT
 
@@ -34,9 +36,15 @@ public:
 
     void setCondensed(bool enabled);
 
+    QString filterText() const;
+
+public slots:
+    void setFilterText(const QString &text);
+
 protected slots:
     void addService(QString service);
     void removeService(QString service);
+    void updateService(QString service);
 
 protected:
     ZConfBrowserWidgetPrivate *const d_ptr;
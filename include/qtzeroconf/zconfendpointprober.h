@@ -0,0 +1,94 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFENDPOINTPROBER_H
+#define ZCONFENDPOINTPROBER_H
+
+#include <functional>
+
+#include <QObject>
+#include <QStringList>
+
+#include "qtzeroconf/zconfglobal.h"
+#include "qtzeroconf/zconfservicebrowser.h"
+
+struct ZConfEndpointHealth
+{
+    enum State
+    {
+        ZCONF_UNKNOWN,
+        ZCONF_UP,
+        ZCONF_DOWN
+    };
+
+    State  state;
+    qreal  rtt;         // Smoothed round trip time in milliseconds, -1 if unknown.
+    qreal  lastRtt;     // Round trip time of the last successful probe.
+    int    failures;    // Consecutive failed probes.
+    qint64 lastProbe;   // Time of the last probe in ms since the epoch, 0 if never.
+};
+
+typedef std::function<void (bool reachable)> ZConfProbeCallback;
+typedef std::function<void (const QString & name, const ZConfServiceEntry & entry, const ZConfProbeCallback & done)> ZConfProbe;
+
+class ZConfEndpointProberPrivate;
+class ZCONF_EXPORT ZConfEndpointProber : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ZConfEndpointProber(ZConfServiceBrowser * browser);
+    ~ZConfEndpointProber();
+
+    void setProbe(const ZConfProbe & probe);
+
+    void setMaxConcurrentProbes(int count);
+    int maxConcurrentProbes() const;
+
+    void setProbeInterval(int msec);
+    int probeInterval() const;
+
+    void setProbeTimeout(int msec);
+    int probeTimeout() const;
+
+    void setSmoothing(qreal alpha);
+    qreal smoothing() const;
+
+    void setFailureThreshold(int failures);
+    int failureThreshold() const;
+
+    ZConfEndpointHealth health(const QString & name) const;
+    QStringList rankedEndpoints() const;
+
+public slots:
+    void probe(const QString & name);
+
+signals:
+    void endpointUp(const QString &) const;
+    void endpointDown(const QString &) const;
+    void healthChanged(const QString &) const;
+
+protected:
+    ZConfEndpointProberPrivate *const d_ptr;
+
+private:
+    Q_DECLARE_PRIVATE(ZConfEndpointProber)
+};
+
+#endif // ZCONFENDPOINTPROBER_H
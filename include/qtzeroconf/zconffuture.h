@@ -0,0 +1,52 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFFUTURE_H
+#define ZCONFFUTURE_H
+
+#include <QEventLoop>
+#include <QFuture>
+#include <QFutureWatcher>
+
+/*!
+    Blocks until \a future has finished and returns its result. The futures
+    returned by QtZeroConf are driven by the event loop of the thread that
+    started the operation, so QFuture::waitForFinished() would dead-lock on
+    that thread. This function runs a local event loop instead, which makes it
+    usable from command line tools and start-up code that do not otherwise
+    run an event loop.
+ */
+template <typename T>
+T zconfAwait(const QFuture<T> & future)
+{
+    if(!future.isFinished())
+    {
+        QEventLoop         loop;
+        QFutureWatcher<T>  watcher;
+        QObject::connect(&watcher, &QFutureWatcher<T>::finished, &loop, &QEventLoop::quit);
+        watcher.setFuture(future);
+        if(!future.isFinished())
+        {
+            loop.exec();
+        }
+    }
+    return future.result();
+}
+
+#endif // ZCONFFUTURE_H
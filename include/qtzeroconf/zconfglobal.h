@@ -0,0 +1,37 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFGLOBAL_H
+#define ZCONFGLOBAL_H
+
+#include <QtGlobal>
+
+// The libraries are built with hidden symbol visibility; only classes marked
+// with ZCONF_EXPORT are visible to applications. ZCONF_LIBRARY is defined
+// while building the libraries and ZCONF_STATIC when the sources are linked
+// statically or compiled directly into an application (see zconf.pri).
+#if defined(ZCONF_STATIC)
+#  define ZCONF_EXPORT
+#elif defined(ZCONF_LIBRARY)
+#  define ZCONF_EXPORT Q_DECL_EXPORT
+#else
+#  define ZCONF_EXPORT Q_DECL_IMPORT
+#endif
+
+#endif // ZCONFGLOBAL_H
@@ -0,0 +1,55 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFHOSTRESOLVER_H
+#define ZCONFHOSTRESOLVER_H
+
+#include <QObject>
+
+#include "qtzeroconf/zconfglobal.h"
+
+class ZCONF_EXPORT ZConfHostResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Protocol
+    {
+        ZCONF_IPV4,
+        ZCONF_IPV6,
+        ZCONF_UNSPEC
+    };
+
+    explicit ZConfHostResolver(QObject * parent = nullptr);
+    ~ZConfHostResolver();
+
+    void resolveHostName(const QString & hostName, Protocol proto = ZCONF_UNSPEC);
+    void resolveAddress(const QString & address);
+
+    static void setCacheTimeToLive(int msec);
+    static int cacheTimeToLive();
+    static void clearCache();
+
+signals:
+    void hostNameResolved(const QString & hostName, const QString & address) const;
+    void addressResolved(const QString & address, const QString & hostName) const;
+    void resolveFailed(const QString & query) const;
+};
+
+#endif // ZCONFHOSTRESOLVER_H
@@ -0,0 +1,78 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFLOCALREGISTRY_H
+#define ZCONFLOCALREGISTRY_H
+
+#include <stdint.h>
+#include <avahi-common/address.h>
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+
+#include "qtzeroconf/zconfglobal.h"
+
+struct ZConfLocalService
+{
+    QString                name;
+    QString                type;
+    QString                domain;
+    QString                host;
+    QString                address;
+    uint16_t               port;
+    AvahiProtocol          protocol;
+    QMap<QString, QString> TXTRecords;
+};
+
+class ZCONF_EXPORT ZConfLocalRegistry : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void servicePublished(const QString & type, const QString & name) const;
+    void serviceUpdated(const QString & type, const QString & name) const;
+    void serviceWithdrawn(const QString & type, const QString & name) const;
+
+private:
+    friend class ZConfService;
+    friend class ZConfServicePrivate;
+    friend class ZConfServiceBrowser;
+    friend class ZConfServiceBrowserPrivate;
+
+    ZConfLocalRegistry();
+    ~ZConfLocalRegistry();
+
+    static ZConfLocalRegistry * instance();
+
+    void publish(const ZConfLocalService & service);
+    void update(const QString & type, const QString & name, const QMap<QString, QString> & TXTRecords);
+    void withdraw(const QString & type, const QString & name);
+    QList<ZConfLocalService> services(const QString & type) const;
+    bool service(const QString & type, const QString & name, ZConfLocalService * out) const;
+
+    typedef QHash<QString, ZConfLocalService> ZConfLocalServiceTable;
+
+    mutable QMutex                          mutex;
+    QHash<QString, ZConfLocalServiceTable>  table;
+};
+
+#endif // ZCONFLOCALREGISTRY_H
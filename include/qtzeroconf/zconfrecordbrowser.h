@@ -0,0 +1,97 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFRECORDBROWSER_H
+#define ZCONFRECORDBROWSER_H
+
+#include <stdint.h>
+#include <avahi-client/lookup.h>
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+
+#include "qtzeroconf/zconfglobal.h"
+
+struct ZConfSrvRecord
+{
+    uint16_t priority;
+    uint16_t weight;
+    uint16_t port;
+    QString  target;
+};
+
+struct ZCONF_EXPORT ZConfRecord
+{
+    enum RecordType
+    {
+        ZCONF_RR_A    = 1,
+        ZCONF_RR_PTR  = 12,
+        ZCONF_RR_TXT  = 16,
+        ZCONF_RR_AAAA = 28,
+        ZCONF_RR_SRV  = 33
+    };
+
+    enum RecordClass
+    {
+        ZCONF_CLASS_IN = 1
+    };
+
+    AvahiIfIndex           interface;
+    AvahiProtocol          protocol;
+    QString                name;
+    uint16_t               clazz;
+    uint16_t               type;
+    QByteArray             rdata;
+    AvahiLookupResultFlags flags;
+
+    static bool decodeA(const QByteArray & rdata, QString * address);
+    static bool decodeAAAA(const QByteArray & rdata, QString * address);
+    static bool decodeName(const QByteArray & rdata, QString * name);
+    static bool decodeSRV(const QByteArray & rdata, ZConfSrvRecord * srv);
+    static bool decodeTXT(const QByteArray & rdata, QList<QByteArray> * strings);
+};
+
+class ZConfRecordBrowserPrivate;
+class ZCONF_EXPORT ZConfRecordBrowser : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ZConfRecordBrowser(QObject * parent = nullptr);
+    ~ZConfRecordBrowser();
+
+    void browse(const QString & name,
+                uint16_t type,
+                uint16_t clazz = ZConfRecord::ZCONF_CLASS_IN);
+
+signals:
+    void recordAdded(const ZConfRecord &) const;
+    void recordRemoved(const ZConfRecord &) const;
+    void recordBrowserFailure() const;
+    void allForNow() const;
+
+protected:
+    ZConfRecordBrowserPrivate *const d_ptr;
+
+private:
+    Q_DECLARE_PRIVATE(ZConfRecordBrowser)
+};
+
+#endif // ZCONFRECORDBROWSER_H
@@ -22,13 +22,49 @@
 
 #include <arpa/inet.h>
 
+#include <QFuture>
+#include <QList>
 #include <QMap>
 #include <QObject>
 
+#include "qtzeroconf/zconfglobal.h"
+
 typedef QMap<QString, QString> QStringMap;
 
+struct ZConfAddressRecord
+{
+    int     interface;
+    QString host;
+    QString address;
+};
+
+struct ZCONF_EXPORT ZConfPublishOptions
+{
+    enum PublishFlag
+    {
+        NoFlags      = 0x0,
+        UseMulticast = 0x1,
+        UseWideArea  = 0x2,
+        NoReverse    = 0x4,
+        NoCookie     = 0x8
+    };
+    Q_DECLARE_FLAGS(PublishFlags, PublishFlag)
+
+    QList<int>                interfaces;
+    QString                   host;
+    QString                   domain;
+    QList<ZConfAddressRecord> addresses;
+    PublishFlags              flags;
+
+    static int interfaceIndex(const QString & name);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(ZConfPublishOptions::PublishFlags)
+
+class ZConfTraceReplay;
+class ZConfTxtRecord;
 class ZConfServicePrivate;
-class ZConfService : public QObject
+class ZCONF_EXPORT ZConfService : public QObject
 {
     Q_OBJECT
 
@@ -46,6 +82,25 @@ public:
     bool isValid() const;
     QString errorString() const;
 
+    void setPublishOptions(const ZConfPublishOptions & options);
+    const ZConfPublishOptions & publishOptions() const;
+
+    QFuture<bool> registerServiceAsync(const QString & name,
+                                       in_port_t port,
+                                       const QString & type = QLatin1String("_http._tcp"),
+                                       const Protocol = ZCONF_IPV4,
+                                       const QStringMap & txtRecords = QStringMap(),
+                                       int timeout = 5000);
+
+    void registerService(const QString & name,
+                         in_port_t port,
+                         const QString & type,
+                         const Protocol protocol,
+                         const ZConfTxtRecord & txt);
+    bool updateServiceTxt(const ZConfTxtRecord & txt);
+
+    void replay(ZConfTraceReplay * trace, const QString & name);
+
 signals:
     void entryGroupFailure()       const;
     void entryGroupEstablished()   const;
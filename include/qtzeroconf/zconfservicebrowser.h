@@ -23,13 +23,33 @@
 #include <stdint.h>
 #include <avahi-client/lookup.h>
 
+#include <QFuture>
+#include <QHash>
 #include <QMap>
 #include <QObject>
+#include <QStringList>
+
+#include "qtzeroconf/zconfglobal.h"
 
 typedef QMap<QString, QString> QStringMap;
 
-struct ZConfServiceEntry
+struct ZCONF_EXPORT ZConfServiceEntry
 {
+    enum Field
+    {
+        NoFields        = 0x000,
+        InterfaceField  = 0x001,
+        IpField         = 0x002,
+        DomainField     = 0x004,
+        TypeField       = 0x008,
+        HostField       = 0x010,
+        PortField       = 0x020,
+        ProtocolField   = 0x040,
+        FlagsField      = 0x080,
+        TXTRecordsField = 0x100
+    };
+    Q_DECLARE_FLAGS(Fields, Field)
+
     AvahiIfIndex           interface;
     QString                ip;
     QString                domain;
@@ -47,10 +67,38 @@ struct ZConfServiceEntry
     inline bool isWideArea()  const { return flags & AVAHI_LOOKUP_RESULT_WIDE_AREA; }
     inline bool isMulticast() const { return flags & AVAHI_LOOKUP_RESULT_MULTICAST; }
 
+    Fields changedFields(const ZConfServiceEntry & other) const;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(ZConfServiceEntry::Fields)
+
+typedef QHash<QString, ZConfServiceEntry> ZConfServiceEntryTable;
+
+struct ZConfServiceChange
+{
+    enum Kind
+    {
+        ZCONF_ADDED,
+        ZCONF_REMOVED,
+        ZCONF_UPDATED
+    };
+
+    quint64                   sequence;
+    Kind                      kind;
+    QString                   name;
+    ZConfServiceEntry::Fields fields;
 };
 
+struct ZConfServiceChangeSet
+{
+    quint64                   sequence;
+    bool                      snapshot;
+    QList<ZConfServiceChange> changes;
+};
+
+class ZConfTraceReplay;
 class ZConfServiceBrowserPrivate;
-class ZConfServiceBrowser : public QObject
+class ZCONF_EXPORT ZConfServiceBrowser : public QObject
 {
     Q_OBJECT
 
@@ -67,10 +115,53 @@ public:
 
     void browse(const QString & serviceType = QLatin1String("_http._tcp"), Protocol proto = ZCONF_UNSPEC);
     const ZConfServiceEntry& serviceEntry(const QString & name) const;
+    ZConfServiceEntryTable serviceEntries() const;
+    QStringList serviceNames() const;
+    QString serviceType() const;
+
+    void setWatchChanges(bool enabled);
+    bool watchChanges() const;
+
+    void addDomain(const QString & domain);
+    void removeDomain(const QString & domain);
+    QStringList domains() const;
+
+    void setDomainEnumeration(bool enabled);
+    bool domainEnumeration() const;
+
+    void setMaxConcurrentResolves(int perDomain);
+    int maxConcurrentResolves() const;
+
+    void setResolveTimeout(int msec);
+    int resolveTimeout() const;
+
+    void setLocalFastPath(bool enabled);
+    bool localFastPath() const;
+
+    quint64 currentSequence() const;
+    ZConfServiceChangeSet changesSince(quint64 sequence) const;
+    void setChangeLogCapacity(int capacity);
+    int changeLogCapacity() const;
+
+    void replay(ZConfTraceReplay * trace, const QString & serviceType);
+
+    static QFuture<ZConfServiceEntryTable> browseOnce(const QString & serviceType = QLatin1String("_http._tcp"),
+                                                      int timeout = 200,
+                                                      Protocol proto = ZCONF_UNSPEC);
+    static QFuture<ZConfServiceEntry> resolve(const QString & name,
+                                              const QString & serviceType = QLatin1String("_http._tcp"),
+                                              int timeout = 200,
+                                              Protocol proto = ZCONF_UNSPEC);
 
 signals:
     void serviceEntryAdded(const QString &) const;
     void serviceEntryRemoved(const QString &) const;
+    void serviceEntryUpdated(const QString &, ZConfServiceEntry::Fields) const;
+    void serviceResolveTimeout(const QString &) const;
+    void serviceBrowserFailure() const;
+    void domainAdded(const QString &) const;
+    void domainRemoved(const QString &) const;
+    void allForNow() const;
 
 protected:
     ZConfServiceBrowserPrivate *const d_ptr;
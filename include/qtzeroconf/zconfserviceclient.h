@@ -23,7 +23,9 @@
 #include <QObject>
 #include <avahi-client/client.h>
 
-class ZConfServiceClient : public QObject
+#include "qtzeroconf/zconfglobal.h"
+
+class ZCONF_EXPORT ZConfServiceClient : public QObject
 {
     Q_OBJECT
 
@@ -37,14 +39,20 @@ private:
     friend class ZConfService;
     friend class ZConfServiceBrowser;
     friend class ZConfServiceBrowserPrivate;
+    friend class ZConfHostCache;
+    friend class ZConfRecordBrowser;
+    friend class ZConfRecordBrowserPrivate;
 
     ZConfServiceClient(QObject *parent = nullptr);
     ~ZConfServiceClient();
 
+    static ZConfServiceClient * shared();
+
     void run();
     QString errorString() const;
 
     static void callback(AvahiClient *client, AvahiClientState state, void *userdata);
+    void stateChanged(AvahiClientState state) const;
 
     const AvahiPoll * const poll;
     AvahiClient     *       client = nullptr;
@@ -0,0 +1,80 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFSHAREDCACHE_H
+#define ZCONFSHAREDCACHE_H
+
+#include <QObject>
+#include <QStringList>
+
+#include "qtzeroconf/zconfglobal.h"
+#include "qtzeroconf/zconfservicebrowser.h"
+
+class ZConfSharedCachePublisherPrivate;
+class ZCONF_EXPORT ZConfSharedCachePublisher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ZConfSharedCachePublisher(ZConfServiceBrowser * browser, int capacity = 4 * 1024 * 1024);
+    ~ZConfSharedCachePublisher();
+
+    bool isValid() const;
+    QString segmentName() const;
+
+    static QString segmentName(const QString & serviceType);
+
+protected:
+    ZConfSharedCachePublisherPrivate *const d_ptr;
+
+private:
+    Q_DECLARE_PRIVATE(ZConfSharedCachePublisher)
+};
+
+class ZConfSharedBrowserPrivate;
+class ZCONF_EXPORT ZConfSharedBrowser : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ZConfSharedBrowser(QObject * parent = nullptr);
+    ~ZConfSharedBrowser();
+
+    void browse(const QString & serviceType = QLatin1String("_http._tcp"));
+    bool isAttached() const;
+
+    const ZConfServiceEntry & serviceEntry(const QString & name) const;
+    ZConfServiceEntryTable serviceEntries() const;
+    QStringList serviceNames() const;
+
+signals:
+    void serviceEntryAdded(const QString &) const;
+    void serviceEntryRemoved(const QString &) const;
+    void serviceEntryUpdated(const QString &, ZConfServiceEntry::Fields) const;
+    void serviceBrowserFailure() const;
+    void allForNow() const;
+
+protected:
+    ZConfSharedBrowserPrivate *const d_ptr;
+
+private:
+    Q_DECLARE_PRIVATE(ZConfSharedBrowser)
+};
+
+#endif // ZCONFSHAREDCACHE_H
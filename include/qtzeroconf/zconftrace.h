@@ -0,0 +1,119 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFTRACE_H
+#define ZCONFTRACE_H
+
+#include <stdint.h>
+#include <avahi-client/client.h>
+#include <avahi-client/lookup.h>
+#include <avahi-client/publish.h>
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+
+#include "qtzeroconf/zconfglobal.h"
+
+struct ZConfBrowserEvent
+{
+    QString                source;
+    QString                browsedDomain;
+    AvahiIfIndex           interface;
+    AvahiProtocol          protocol;
+    AvahiBrowserEvent      event;
+    QString                name;
+    QString                type;
+    QString                domain;
+    AvahiLookupResultFlags flags;
+    int                    error;
+};
+
+struct ZConfResolverEvent
+{
+    QString                source;
+    AvahiIfIndex           interface;
+    AvahiProtocol          protocol;
+    AvahiResolverEvent     event;
+    QString                name;
+    QString                type;
+    QString                domain;
+    QString                host;
+    QString                address;
+    uint16_t               port;
+    QList<QByteArray>      TXTRecords;
+    AvahiLookupResultFlags flags;
+    int                    error;
+};
+
+struct ZConfEntryGroupEvent
+{
+    QString              name;
+    AvahiEntryGroupState state;
+    int                  error;
+};
+
+class ZCONF_EXPORT ZConfTrace
+{
+public:
+    static bool startRecording(const QString & fileName);
+    static void stopRecording();
+    static inline bool isRecording() { return 0 != recording.load(); }
+
+    static void recordClientState(AvahiClientState state);
+    static void recordBrowserEvent(const ZConfBrowserEvent & event);
+    static void recordResolverEvent(const ZConfResolverEvent & event);
+    static void recordEntryGroupEvent(const ZConfEntryGroupEvent & event);
+
+private:
+    static QAtomicInt recording;
+};
+
+class ZConfTraceReplayPrivate;
+class ZCONF_EXPORT ZConfTraceReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ZConfTraceReplay(QObject * parent = nullptr);
+    ~ZConfTraceReplay();
+
+    bool load(const QString & fileName);
+    int eventCount() const;
+
+    void start(qreal speed = 1.0);
+    void stop();
+    bool isRunning() const;
+
+signals:
+    void clientStateChanged(AvahiClientState) const;
+    void browserEvent(const ZConfBrowserEvent &) const;
+    void resolverEvent(const ZConfResolverEvent &) const;
+    void entryGroupEvent(const ZConfEntryGroupEvent &) const;
+    void finished() const;
+
+protected:
+    ZConfTraceReplayPrivate *const d_ptr;
+
+private:
+    Q_DECLARE_PRIVATE(ZConfTraceReplay)
+};
+
+#endif // ZCONFTRACE_H
@@ -0,0 +1,70 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef ZCONFTXTRECORD_H
+#define ZCONFTXTRECORD_H
+
+#include <avahi-common/strlst.h>
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QSharedDataPointer>
+
+#include "qtzeroconf/zconfglobal.h"
+
+typedef QMap<QString, QString> QStringMap;
+
+class ZConfTxtRecordData;
+class ZCONF_EXPORT ZConfTxtRecord
+{
+public:
+    enum
+    {
+        MaxStringSize = 255
+    };
+
+    ZConfTxtRecord();
+    explicit ZConfTxtRecord(const QStringMap & records);
+    ZConfTxtRecord(const ZConfTxtRecord & other);
+    ZConfTxtRecord & operator=(const ZConfTxtRecord & other);
+    ~ZConfTxtRecord();
+
+    bool add(const QByteArray & key, const QByteArray & value);
+    bool addFlag(const QByteArray & key);
+    bool contains(const QByteArray & key) const;
+    void clear();
+
+    bool isEmpty() const;
+    int count() const;
+    int size() const;
+
+    QList<QByteArray> strings() const;
+    QStringMap toMap() const;
+
+    static bool isValidKey(const QByteArray & key);
+
+private:
+    friend class ZConfService;
+    AvahiStringList * stringList() const;
+
+    QSharedDataPointer<ZConfTxtRecordData> d;
+};
+
+#endif // ZCONFTXTRECORD_H
@@ -2,7 +2,7 @@ PROJ_DIR     = $$PWD
 
 QT          -= gui
 QT          += core
-CONFIG      += c++11 debug
+CONFIG      += c++11 hide_symbols
 VERSION      = 0.0.1
 
 DESTDIR      = $$PROJ_DIR/bin
@@ -13,8 +13,25 @@ RCC_DIR      = .rcc
 OBJECTS_DIR  = .obj
 
 INCLUDEPATH += $$PROJ_DIR/include
+DEFINES     += ZCONF_LIBRARY
 
-QMAKE_CXXFLAGS += -Wall -Wcast-align -Wextra -Wfloat-equal -Wformat=2 -Wformat-nonliteral -Wmissing-braces -Wmissing-declarations -Wmissing-field-initializers -Wmissing-format-attribute -Wmissing-noreturn -Woverlength-strings -Wparentheses -Wpointer-arith -Wredundant-decls -Wreturn-type -Wsequence-point -Wsign-compare -Wswitch -Wuninitialized -Wunknown-pragmas -Wunused-function -Wunused-label -Wunused-parameter -Wunused-value -Wunused-variable -Wwrite-strings -O3
+# Build options, e.g. "qmake CONFIG+=zconf_single CONFIG+=zconf_lto":
+#   zconf_single  build a single qtzeroconf library instead of one per module
+#   zconf_static  build static libraries
+#   zconf_lto     enable link time optimization
+zconf_static {
+    CONFIG  += staticlib
+    DEFINES += ZCONF_STATIC
+}
+zconf_lto: CONFIG += ltcg
+
+CONFIG(release, debug|release) {
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+    QMAKE_CXXFLAGS_RELEASE += -O3
+    DEFINES                += QT_NO_DEBUG_OUTPUT
+}
+
+QMAKE_CXXFLAGS += -Wall -Wcast-align -Wextra -Wfloat-equal -Wformat=2 -Wformat-nonliteral -Wmissing-braces -Wmissing-declarations -Wmissing-field-initializers -Wmissing-format-attribute -Wmissing-noreturn -Woverlength-strings -Wparentheses -Wpointer-arith -Wredundant-decls -Wreturn-type -Wsequence-point -Wsign-compare -Wswitch -Wuninitialized -Wunknown-pragmas -Wunused-function -Wunused-label -Wunused-parameter -Wunused-value -Wunused-variable -Wwrite-strings
 
 *clang* {
     QMAKE_CXXFLAGS += -Wdeprecated-implementations -Wfour-char-constants -Wimplicit-atomic-properties -Wnewline-eof -Wswitch-default -Wshadow -Wbad-function-cast -Wdeclaration-after-statement -Wmissing-prototypes -Wnested-externs -Wold-style-definition -Wstrict-prototypes -Wstrict-selector-match -Wundeclared-selector
@@ -1,2 +1,8 @@
 TEMPLATE = subdirs
 SUBDIRS = src
+
+# The tests are skipped if Qt was built without QtTest.
+qtHaveModule(testlib):qtHaveModule(network) {
+    SUBDIRS      += tests
+    tests.depends = src
+}
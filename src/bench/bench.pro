@@ -0,0 +1,19 @@
+include(../../project_settings.pri)
+zconf_single {
+    DEPENDENCY_LIBRARIES = qtzeroconf
+    DEFINES             += ZCONF_BENCH_LAYOUT=\\\"single\\\"
+} else {
+    DEPENDENCY_LIBRARIES = qtzeroconf-browser qtzeroconf-common
+    DEFINES             += ZCONF_BENCH_LAYOUT=\\\"split\\\"
+}
+include(../../dependency.pri)
+TARGET     = zconf-bench
+TEMPLATE   = app
+CONFIG    += console link_pkgconfig
+CONFIG    -= app_bundle
+PKGCONFIG += avahi-qt5 avahi-client
+DEFINES   -= ZCONF_LIBRARY
+
+INCLUDEPATH += $$PROJ_DIR/include/
+SOURCES     += main.cpp
+LIBS        += -lrt
@@ -0,0 +1,129 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+// Measures the time from process start until the first browse has reported
+// all services, which is what a short-lived client of the library pays on
+// every run. Build it once with and once without CONFIG+=zconf_single to
+// compare the split and single library layouts.
+//
+//   zconf-bench [runs] [service type]
+//
+// The benchmark starts itself once per run and times each child process,
+// so dynamic loading and relocation are included in the figures.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+#include "qtzeroconf/zconfservicebrowser.h"
+
+#ifndef ZCONF_BENCH_LAYOUT
+#define ZCONF_BENCH_LAYOUT "unknown"
+#endif
+
+namespace
+{
+    const char * const childVariable = "ZCONF_BENCH_CHILD";
+
+    // Browses once and exits with 0 on allForNow(), 1 on failure and 2 if
+    // the daemon has not reported all services within five seconds.
+    int runChild(QCoreApplication & app, const QString & type)
+    {
+        ZConfServiceBrowser browser;
+        QObject::connect(&browser, &ZConfServiceBrowser::allForNow, &app, []()
+        {
+            QCoreApplication::exit(0);
+        });
+        QObject::connect(&browser, &ZConfServiceBrowser::serviceBrowserFailure, &app, []()
+        {
+            QCoreApplication::exit(1);
+        });
+        QTimer::singleShot(5000, &app, []()
+        {
+            QCoreApplication::exit(2);
+        });
+        browser.browse(type);
+        return app.exec();
+    }
+
+    int runDriver(const QString & program, int const runs, const QString & type)
+    {
+        QTextStream out(stdout);
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert(QLatin1String(childVariable), QLatin1String("1"));
+
+        QVector<qint64> times;
+        times.reserve(runs);
+        for(int run = 0; run < runs; ++run)
+        {
+            QProcess child;
+            child.setProcessEnvironment(environment);
+            child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+
+            QElapsedTimer timer;
+            timer.start();
+            child.start(program, QStringList() << type);
+            if(!child.waitForFinished(10000) || QProcess::NormalExit != child.exitStatus() || 0 != child.exitCode())
+            {
+                out << "run " << run << " failed (exit code " << child.exitCode() << ")" << endl;
+                return 1;
+            }
+            times.append(timer.nsecsElapsed() / 1000);
+        }
+
+        std::sort(times.begin(), times.end());
+        qint64 total = 0;
+        for(qint64 const time : times)
+        {
+            total += time;
+        }
+        out << ZCONF_BENCH_LAYOUT << " layout, " << runs << " runs browsing " << type << endl
+            << "  min    " << times.first()     << " us" << endl
+            << "  median " << times.at(runs / 2) << " us" << endl
+            << "  mean   " << total / runs       << " us" << endl
+            << "  max    " << times.last()       << " us" << endl;
+        return 0;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+
+    if(qEnvironmentVariableIsSet(childVariable))
+    {
+        return runChild(app, arguments.value(1, QLatin1String("_http._tcp")));
+    }
+
+    bool valid = false;
+    int const runs = arguments.value(1).toInt(&valid);
+    if(1 < arguments.size() && (!valid || 1 > runs))
+    {
+        QTextStream(stderr) << "usage: " << arguments.first() << " [runs] [service type]" << endl;
+        return 1;
+    }
+    return runDriver(app.applicationFilePath(),
+                     valid ? runs : 20,
+                     arguments.value(2, QLatin1String("_http._tcp")));
+}
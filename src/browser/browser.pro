@@ -7,5 +7,14 @@ CONFIG    += link_pkgconfig
 PKGCONFIG += avahi-qt5 avahi-client
 
 INCLUDEPATH += $$PROJ_DIR/include/
-SOURCES     += zconfservicebrowser.cpp
-HEADERS     += $$PROJ_DIR/include/qtzeroconf/zconfservicebrowser.h
+SOURCES     += zconfservicebrowser.cpp \
+               zconfhostresolver.cpp \
+               zconfrecordbrowser.cpp \
+               zconfsharedcache.cpp \
+               zconfendpointprober.cpp
+HEADERS     += $$PROJ_DIR/include/qtzeroconf/zconfservicebrowser.h \
+               $$PROJ_DIR/include/qtzeroconf/zconfhostresolver.h \
+               $$PROJ_DIR/include/qtzeroconf/zconfrecordbrowser.h \
+               $$PROJ_DIR/include/qtzeroconf/zconfsharedcache.h \
+               $$PROJ_DIR/include/qtzeroconf/zconfendpointprober.h
+LIBS        += -lrt
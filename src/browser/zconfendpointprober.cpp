@@ -0,0 +1,528 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <QDebug>
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
+#include <QSocketNotifier>
+#include <QStringBuilder>
+#include <QTimer>
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "qtzeroconf/zconfendpointprober.h"
+
+namespace
+{
+    // Connects to the entry's address and port without blocking. The probe
+    // succeeds once the connection is established and is closed right away.
+    class ZConfTcpProbe : public QObject
+    {
+    public:
+        ZConfTcpProbe(const ZConfProbeCallback & in_done, QObject * const parent)
+            : QObject(parent)
+            , done(in_done)
+        { }
+
+        ~ZConfTcpProbe()
+        {
+            if(0 <= fd)
+            {
+                ::close(fd);
+            }
+        }
+
+        void start(const ZConfServiceEntry & entry, int const timeout)
+        {
+            sockaddr_storage address = sockaddr_storage();
+            socklen_t        length  = 0;
+            const QByteArray ip      = entry.ip.toLatin1();
+            sockaddr_in  * const ipv4 = reinterpret_cast<sockaddr_in *>(&address);
+            sockaddr_in6 * const ipv6 = reinterpret_cast<sockaddr_in6 *>(&address);
+            if(1 == inet_pton(AF_INET, ip.constData(), &ipv4->sin_addr))
+            {
+                ipv4->sin_family = AF_INET;
+                ipv4->sin_port   = htons(entry.port);
+                length           = sizeof(sockaddr_in);
+            }
+            else if(1 == inet_pton(AF_INET6, ip.constData(), &ipv6->sin6_addr))
+            {
+                ipv6->sin6_family   = AF_INET6;
+                ipv6->sin6_port     = htons(entry.port);
+                // Link-local addresses are only meaningful on the interface
+                // they were announced on.
+                ipv6->sin6_scope_id = 0 < entry.interface ? uint32_t(entry.interface) : 0;
+                length              = sizeof(sockaddr_in6);
+            }
+            else
+            {
+                finishLater(false);
+                return;
+            }
+
+            fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if(0 > fd)
+            {
+                finishLater(false);
+                return;
+            }
+            if(0 == ::connect(fd, reinterpret_cast<const sockaddr *>(&address), length))
+            {
+                finishLater(true);
+                return;
+            }
+            if(EINPROGRESS != errno)
+            {
+                finishLater(false);
+                return;
+            }
+
+            QSocketNotifier * const notifier = new QSocketNotifier(fd, QSocketNotifier::Write, this);
+            connect(notifier, &QSocketNotifier::activated, this, [this, notifier]()
+            {
+                notifier->setEnabled(false);
+                int       error  = 0;
+                socklen_t length = sizeof(error);
+                finish(0 == getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) && 0 == error);
+            });
+            QTimer::singleShot(timeout, this, [this]()
+            {
+                finish(false);
+            });
+        }
+
+    private:
+        // Results are never reported from within start().
+        void finishLater(bool const reachable)
+        {
+            QTimer::singleShot(0, this, [this, reachable]()
+            {
+                finish(reachable);
+            });
+        }
+
+        void finish(bool const reachable)
+        {
+            if(finished)
+            {
+                return;
+            }
+            finished = true;
+            done(reachable);
+            deleteLater();
+        }
+
+        ZConfProbeCallback done;
+        int                fd       = -1;
+        bool               finished = false;
+    };
+
+    struct ZConfEndpoint
+    {
+        ZConfEndpointHealth health;
+        quint64             generation;
+        bool                queued;
+        bool                probing;
+    };
+}
+
+class ZConfEndpointProberPrivate
+{
+public:
+    ZConfEndpointProberPrivate(ZConfEndpointProber * const in_q, ZConfServiceBrowser * const in_browser)
+        : q(in_q)
+        , browser(in_browser)
+    {
+        probe = [this](const QString & name, const ZConfServiceEntry & entry, const ZConfProbeCallback & done)
+        {
+            Q_UNUSED(name);
+            (new ZConfTcpProbe(done, q))->start(entry, timeout);
+        };
+        QObject::connect(&ticker, &QTimer::timeout, [this]()
+        {
+            reprobe();
+        });
+        ticker.start(qMin(interval, 1000));
+    }
+
+    void add(const QString & name)
+    {
+        endpoints.insert(name, {{ZConfEndpointHealth::ZCONF_UNKNOWN, -1, -1, 0, 0}, ++generations, false, false});
+        enqueue(name);
+    }
+
+    void enqueue(const QString & name)
+    {
+        QHash<QString, ZConfEndpoint>::iterator it = endpoints.find(name);
+        if(endpoints.end() == it || it->queued || it->probing)
+        {
+            return;
+        }
+        it->queued = true;
+        queue.append(name);
+        pump();
+    }
+
+    // Starts queued probes while there is room. Entries of endpoints that
+    // were removed or reset while queued are skipped.
+    void pump()
+    {
+        while(inFlight < maxConcurrent && !queue.isEmpty())
+        {
+            const QString name = queue.takeFirst();
+            QHash<QString, ZConfEndpoint>::iterator it = endpoints.find(name);
+            if(endpoints.end() == it || !it->queued)
+            {
+                continue;
+            }
+            const ZConfServiceEntry & entry = browser->serviceEntry(name);
+            if(!entry.isValid())
+            {
+                it->queued = false;
+                continue;
+            }
+            it->queued            = false;
+            it->probing           = true;
+            it->health.lastProbe  = QDateTime::currentMSecsSinceEpoch();
+            ++inFlight;
+            start(name, it->generation, entry);
+        }
+    }
+
+    void start(const QString & name, quint64 const generation, const ZConfServiceEntry & entry)
+    {
+        // Whichever of the probe's result and the timeout comes first
+        // counts; the other is ignored.
+        const std::shared_ptr<bool>          finished = std::make_shared<bool>(false);
+        const QPointer<ZConfEndpointProber>  guard(q);
+        const std::shared_ptr<QElapsedTimer> clock    = std::make_shared<QElapsedTimer>();
+        const ZConfProbeCallback done = [this, guard, finished, clock, name, generation](bool const reachable)
+        {
+            if(guard.isNull() || *finished)
+            {
+                return;
+            }
+            *finished = true;
+            --inFlight;
+            complete(name, generation, reachable, clock->nsecsElapsed() / 1000000.0);
+            pump();
+        };
+        clock->start();
+        QTimer::singleShot(timeout, q, [done]()
+        {
+            done(false);
+        });
+        probe(name, entry, done);
+    }
+
+    void complete(const QString & name, quint64 const generation, bool const reachable, qreal const rtt)
+    {
+        QHash<QString, ZConfEndpoint>::iterator it = endpoints.find(name);
+        if(endpoints.end() == it || generation != it->generation)
+        {
+            return;
+        }
+        it->probing = false;
+
+        ZConfEndpointHealth & health = it->health;
+        const ZConfEndpointHealth::State previous = health.state;
+        if(reachable)
+        {
+            health.lastRtt  = rtt;
+            health.rtt      = 0 > health.rtt ? rtt : alpha * rtt + (1 - alpha) * health.rtt;
+            health.failures = 0;
+            health.state    = ZConfEndpointHealth::ZCONF_UP;
+        }
+        else if(failureThreshold <= ++health.failures)
+        {
+            health.state = ZConfEndpointHealth::ZCONF_DOWN;
+        }
+
+        emit q->healthChanged(name);
+        if(previous != health.state)
+        {
+            if(ZConfEndpointHealth::ZCONF_UP == health.state)
+            {
+                emit q->endpointUp(name);
+            }
+            else if(ZConfEndpointHealth::ZCONF_DOWN == health.state)
+            {
+                emit q->endpointDown(name);
+            }
+        }
+    }
+
+    void reprobe()
+    {
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        QStringList due;
+        for(QHash<QString, ZConfEndpoint>::const_iterator it = endpoints.constBegin(); it != endpoints.constEnd(); ++it)
+        {
+            if(!it->queued && !it->probing && it->health.lastProbe + interval <= now)
+            {
+                due.append(it.key());
+            }
+        }
+        for(const QString & name : due)
+        {
+            enqueue(name);
+        }
+    }
+
+    ZConfEndpointProber           * const q;
+    ZConfServiceBrowser           * const browser;
+    ZConfProbe                            probe;
+    QHash<QString, ZConfEndpoint>         endpoints;
+    QList<QString>                        queue;
+    QTimer                                ticker;
+    quint64                               generations      = 0;
+    int                                   inFlight         = 0;
+    int                                   maxConcurrent    = 8;
+    int                                   interval         = 30000;
+    int                                   timeout          = 2000;
+    int                                   failureThreshold = 2;
+    qreal                                 alpha            = 0.3;
+};
+
+/*!
+    \class ZConfEndpointProber
+
+    \brief Checks whether the services found by a ZConfServiceBrowser accept
+    connections, and ranks them by round trip time.
+
+    A resolved service only tells that someone announced an address and a
+    port. The prober connects to every resolved service without blocking,
+    at most maxConcurrentProbes() at a time, and probes it again every
+    probeInterval() milliseconds. Successful probes update a smoothed round
+    trip time; after failureThreshold() consecutive failures a service is
+    considered down. health() returns these attributes for a service and
+    rankedEndpoints() the reachable services, fastest first.
+
+    By default a probe is a TCP connect to the service's address and port.
+    setProbe() replaces it, e.g. with an application level request.
+ */
+
+/*!
+    Creates a prober for the services of \a browser. The prober is a child of
+    the browser.
+ */
+ZConfEndpointProber::ZConfEndpointProber(ZConfServiceBrowser * const browser)
+    : QObject(browser),
+      d_ptr(new ZConfEndpointProberPrivate(this, browser))
+{
+    connect(browser, &ZConfServiceBrowser::serviceEntryAdded, this, [this](const QString & name)
+    {
+        d_ptr->add(name);
+    });
+    connect(browser, &ZConfServiceBrowser::serviceEntryRemoved, this, [this](const QString & name)
+    {
+        d_ptr->endpoints.remove(name);
+    });
+    connect(browser, &ZConfServiceBrowser::serviceEntryUpdated, this, [this](const QString & name, ZConfServiceEntry::Fields fields)
+    {
+        // A new address means a new endpoint; its history does not apply.
+        static const ZConfServiceEntry::Fields endpointFields = ZConfServiceEntry::InterfaceField
+                                                              | ZConfServiceEntry::IpField
+                                                              | ZConfServiceEntry::PortField
+                                                              | ZConfServiceEntry::ProtocolField;
+        if((fields & endpointFields) || !d_ptr->endpoints.contains(name))
+        {
+            d_ptr->add(name);
+        }
+    });
+
+    const ZConfServiceEntryTable entries = browser->serviceEntries();
+    for(ZConfServiceEntryTable::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it)
+    {
+        d_ptr->add(it.key());
+    }
+}
+
+/*!
+    Destroys the prober. Probes still running are abandoned.
+ */
+ZConfEndpointProber::~ZConfEndpointProber()
+{
+    delete d_ptr;
+}
+
+/*!
+    Replaces the TCP connect probe with \a probe. The probe is called with
+    the name and entry of a service and must call the callback it is given
+    exactly once, with true if the service is reachable. The prober measures
+    the time until the callback is called and gives up after probeTimeout().
+ */
+void ZConfEndpointProber::setProbe(const ZConfProbe & probe)
+{
+    d_ptr->probe = probe;
+}
+
+/*!
+    Limits the number of probes running at the same time to \a count. The
+    default is 8.
+ */
+void ZConfEndpointProber::setMaxConcurrentProbes(int count)
+{
+    d_ptr->maxConcurrent = qMax(1, count);
+    d_ptr->pump();
+}
+
+/*!
+    Returns the maximum number of probes running at the same time.
+ */
+int ZConfEndpointProber::maxConcurrentProbes() const
+{
+    return d_ptr->maxConcurrent;
+}
+
+/*!
+    Sets the time between two probes of the same service to \a msec
+    milliseconds. The default is 30 seconds.
+ */
+void ZConfEndpointProber::setProbeInterval(int msec)
+{
+    d_ptr->interval = qMax(1, msec);
+    d_ptr->ticker.start(qMin(d_ptr->interval, 1000));
+}
+
+/*!
+    Returns the time between two probes of the same service in milliseconds.
+ */
+int ZConfEndpointProber::probeInterval() const
+{
+    return d_ptr->interval;
+}
+
+/*!
+    Sets the time after which a probe counts as failed to \a msec
+    milliseconds. The default is 2 seconds.
+ */
+void ZConfEndpointProber::setProbeTimeout(int msec)
+{
+    d_ptr->timeout = qMax(1, msec);
+}
+
+/*!
+    Returns the probe timeout in milliseconds.
+ */
+int ZConfEndpointProber::probeTimeout() const
+{
+    return d_ptr->timeout;
+}
+
+/*!
+    Sets the weight \a alpha of a new round trip time in the smoothed round
+    trip time, between 0 and 1. The default is 0.3.
+ */
+void ZConfEndpointProber::setSmoothing(qreal alpha)
+{
+    d_ptr->alpha = qBound(qreal(0), alpha, qreal(1));
+}
+
+/*!
+    Returns the weight of a new round trip time in the smoothed round trip
+    time.
+ */
+qreal ZConfEndpointProber::smoothing() const
+{
+    return d_ptr->alpha;
+}
+
+/*!
+    Sets the number of consecutive failed probes after which a service is
+    considered down. The default is 2.
+ */
+void ZConfEndpointProber::setFailureThreshold(int failures)
+{
+    d_ptr->failureThreshold = qMax(1, failures);
+}
+
+/*!
+    Returns the number of consecutive failed probes after which a service is
+    considered down.
+ */
+int ZConfEndpointProber::failureThreshold() const
+{
+    return d_ptr->failureThreshold;
+}
+
+/*!
+    Returns the health of the service \a name. Services that are unknown or
+    have not been probed yet are in the ZCONF_UNKNOWN state.
+ */
+ZConfEndpointHealth ZConfEndpointProber::health(const QString & name) const
+{
+    QHash<QString, ZConfEndpoint>::const_iterator it = d_ptr->endpoints.constFind(name);
+    if(d_ptr->endpoints.constEnd() == it)
+    {
+        return {ZConfEndpointHealth::ZCONF_UNKNOWN, -1, -1, 0, 0};
+    }
+    return it->health;
+}
+
+/*!
+    Returns the services that are up, ordered by their smoothed round trip
+    time, followed by those that have not been probed yet. Services that are
+    down are left out.
+ */
+QStringList ZConfEndpointProber::rankedEndpoints() const
+{
+    QList<QPair<qreal, QString> > up;
+    QStringList unknown;
+    for(QHash<QString, ZConfEndpoint>::const_iterator it = d_ptr->endpoints.constBegin(); it != d_ptr->endpoints.constEnd(); ++it)
+    {
+        if(ZConfEndpointHealth::ZCONF_UP == it->health.state)
+        {
+            up.append(qMakePair(it->health.rtt, it.key()));
+        }
+        else if(ZConfEndpointHealth::ZCONF_UNKNOWN == it->health.state)
+        {
+            unknown.append(it.key());
+        }
+    }
+    std::sort(up.begin(), up.end());
+    std::sort(unknown.begin(), unknown.end());
+
+    QStringList ranked;
+    ranked.reserve(up.size() + unknown.size());
+    for(const QPair<qreal, QString> & endpoint : up)
+    {
+        ranked.append(endpoint.second);
+    }
+    return ranked + unknown;
+}
+
+/*!
+    Probes the service \a name as soon as possible, without waiting for the
+    probe interval.
+ */
+void ZConfEndpointProber::probe(const QString & name)
+{
+    d_ptr->enqueue(name);
+}
@@ -0,0 +1,517 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <QDebug>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QStringBuilder>
+#include <QTimer>
+
+#include <avahi-client/lookup.h>
+#include <avahi-common/error.h>
+
+#include "qtzeroconf/zconfserviceclient.h"
+#include "qtzeroconf/zconfhostresolver.h"
+
+namespace
+{
+    // Host records are announced with a TTL of 120 seconds in mDNS
+    // (RFC 6762, section 10), which is also used for the cache by default.
+    static QAtomicInt timeToLive(120000);
+
+    // Avahi gives up on a lookup after a few seconds; this only catches
+    // lookups that never reach a working daemon.
+    static const qint64 queryTimeout = 10000;
+
+    enum ZConfQueryKind
+    {
+        ZCONF_HOST_QUERY,
+        ZCONF_ADDRESS_QUERY
+    };
+
+    struct ZConfQueryKey
+    {
+        ZConfQueryKind kind;
+        QString        query;
+        AvahiProtocol  protocol;
+    };
+
+    inline bool operator==(const ZConfQueryKey & a, const ZConfQueryKey & b)
+    {
+        return (   (a.kind     == b.kind)
+                && (a.protocol == b.protocol)
+                && (a.query    == b.query));
+    }
+
+    inline uint qHash(const ZConfQueryKey & key, uint seed = 0)
+    {
+        return ::qHash(key.query, seed) ^ (uint(key.kind) << 8) ^ uint(key.protocol);
+    }
+
+    struct ZConfCachedResult
+    {
+        QString value;
+        qint64  expires;
+    };
+
+    static AvahiProtocol convertProtocol(ZConfHostResolver::Protocol proto)
+    {
+        switch(proto)
+        {
+            case ZConfHostResolver::ZCONF_IPV4: return AVAHI_PROTO_INET;
+            case ZConfHostResolver::ZCONF_IPV6: return AVAHI_PROTO_INET6;
+            default:                            return AVAHI_PROTO_UNSPEC;
+        }
+    }
+}
+
+class ZConfHostCache;
+
+namespace
+{
+    // One lookup in flight, shared by every resolver that asked for the same
+    // thing while it was running.
+    struct ZConfPendingQuery
+    {
+        ZConfHostCache                        * cache;
+        ZConfQueryKey                           key;
+        AvahiHostNameResolver                 * hostResolver;
+        AvahiAddressResolver                  * addressResolver;
+        qint64                                  started;
+        QList<QPointer<ZConfHostResolver> >     waiters;
+    };
+}
+
+/*
+    Per-thread cache and lookup table behind ZConfHostResolver. It is a child
+    of the thread's shared client, so it goes away together with the client,
+    which frees any Avahi resolvers still running.
+ */
+class ZConfHostCache : public QObject
+{
+public:
+    static ZConfHostCache * local()
+    {
+        if(nullptr == instance)
+        {
+            instance = new ZConfHostCache(ZConfServiceClient::shared());
+        }
+        return instance;
+    }
+
+    bool lookup(const ZConfQueryKey & key, QString * const value)
+    {
+        const QHash<ZConfQueryKey, ZConfCachedResult>::iterator it = cache.find(key);
+        if(cache.end() == it)
+        {
+            return false;
+        }
+        if(it->expires <= clock.elapsed())
+        {
+            cache.erase(it);
+            return false;
+        }
+        *value = it->value;
+        return true;
+    }
+
+    void request(const ZConfQueryKey & key, ZConfHostResolver * const waiter)
+    {
+        ZConfPendingQuery * query = pending.value(key);
+        if(nullptr != query)
+        {
+            query->waiters.append(waiter);
+            return;
+        }
+
+        query = new ZConfPendingQuery{this, key, nullptr, nullptr, clock.elapsed(), QList<QPointer<ZConfHostResolver> >()};
+        query->waiters.append(waiter);
+        pending.insert(key, query);
+        if(!sweeper.isActive())
+        {
+            sweeper.start(1000);
+        }
+
+        // A client that could not connect to the daemon is retried; one that
+        // lost the daemon cannot recover, so its lookups fail right away.
+        client->run();
+        if(   (nullptr == client->client)
+           || (AVAHI_CLIENT_FAILURE == avahi_client_get_state(client->client)))
+        {
+            qDebug() << (QLatin1String("Failed to resolve '") % key.query % QLatin1String("': The Avahi daemon is not available."));
+            finish(query, false, QString());
+        }
+        else if(AVAHI_CLIENT_S_RUNNING == avahi_client_get_state(client->client))
+        {
+            start(query);
+        }
+    }
+
+    void clear()
+    {
+        cache.clear();
+    }
+
+private:
+    explicit ZConfHostCache(ZConfServiceClient * const in_client)
+        : QObject(in_client)
+        , client(in_client)
+    {
+        clock.start();
+        // Finishing a query emits signals whose slots may start or finish
+        // other queries, so every query is looked up again before use.
+        connect(client, &ZConfServiceClient::clientRunning, this, [this]()
+        {
+            for(const ZConfQueryKey & key : pending.keys())
+            {
+                ZConfPendingQuery * const query = pending.value(key);
+                if(   (nullptr != query)
+                   && (nullptr == query->hostResolver)
+                   && (nullptr == query->addressResolver))
+                {
+                    start(query);
+                }
+            }
+        });
+        connect(client, &ZConfServiceClient::clientFailure, this, [this]()
+        {
+            for(const ZConfQueryKey & key : pending.keys())
+            {
+                ZConfPendingQuery * const query = pending.value(key);
+                if(nullptr != query)
+                {
+                    finish(query, false, QString());
+                }
+            }
+        });
+        connect(&sweeper, &QTimer::timeout, this, [this]()
+        {
+            sweep();
+        });
+    }
+
+    ~ZConfHostCache()
+    {
+        qDeleteAll(pending);
+        instance = nullptr;
+    }
+
+    void start(ZConfPendingQuery * const query)
+    {
+        const QByteArray text = query->key.query.toLocal8Bit();
+        if(ZCONF_HOST_QUERY == query->key.kind)
+        {
+            query->hostResolver = avahi_host_name_resolver_new(client->client,
+                                                               AVAHI_IF_UNSPEC,
+                                                               AVAHI_PROTO_UNSPEC,
+                                                               text.data(),
+                                                               query->key.protocol,
+                                                               (AvahiLookupFlags) 0,
+                                                               ZConfHostCache::hostCallback,
+                                                               query);
+            if(nullptr == query->hostResolver)
+            {
+                qDebug() << (QLatin1String("Failed to resolve host '") % query->key.query % QLatin1String("': ") % avahi_strerror(avahi_client_errno(client->client)));
+                finish(query, false, QString());
+            }
+            return;
+        }
+
+        AvahiAddress address;
+        if(nullptr != avahi_address_parse(text.data(), AVAHI_PROTO_UNSPEC, &address))
+        {
+            query->addressResolver = avahi_address_resolver_new(client->client,
+                                                                AVAHI_IF_UNSPEC,
+                                                                AVAHI_PROTO_UNSPEC,
+                                                                &address,
+                                                                (AvahiLookupFlags) 0,
+                                                                ZConfHostCache::addressCallback,
+                                                                query);
+        }
+        if(nullptr == query->addressResolver)
+        {
+            qDebug() << (QLatin1String("Failed to resolve address '") % query->key.query % QLatin1String("'."));
+            finish(query, false, QString());
+        }
+    }
+
+    // Drops expired results and fails lookups that have been pending for
+    // longer than queryTimeout.
+    void sweep()
+    {
+        const qint64 now = clock.elapsed();
+        for(QHash<ZConfQueryKey, ZConfCachedResult>::iterator it = cache.begin(); it != cache.end(); )
+        {
+            it = (it->expires <= now) ? cache.erase(it) : it + 1;
+        }
+
+        QList<ZConfQueryKey> expired;
+        for(const ZConfPendingQuery * const query : pending)
+        {
+            if(query->started + queryTimeout <= now)
+            {
+                expired.append(query->key);
+            }
+        }
+        for(const ZConfQueryKey & key : expired)
+        {
+            ZConfPendingQuery * const query = pending.value(key);
+            if(nullptr != query)
+            {
+                qDebug() << (QLatin1String("Resolving '") % key.query % QLatin1String("' timed out."));
+                finish(query, false, QString());
+            }
+        }
+
+        if(cache.isEmpty() && pending.isEmpty())
+        {
+            sweeper.stop();
+        }
+    }
+
+    // Caches a successful result and reports it to every resolver still
+    // waiting for it.
+    void finish(ZConfPendingQuery * const query, bool const found, const QString & value)
+    {
+        pending.remove(query->key);
+        if(nullptr != query->hostResolver)
+        {
+            avahi_host_name_resolver_free(query->hostResolver);
+        }
+        if(nullptr != query->addressResolver)
+        {
+            avahi_address_resolver_free(query->addressResolver);
+        }
+        if(found)
+        {
+            cache.insert(query->key, {value, clock.elapsed() + timeToLive.load()});
+            if(!sweeper.isActive())
+            {
+                sweeper.start(1000);
+            }
+        }
+
+        const ZConfQueryKey key = query->key;
+        const QList<QPointer<ZConfHostResolver> > waiters = query->waiters;
+        delete query;
+
+        for(const QPointer<ZConfHostResolver> & waiter : waiters)
+        {
+            if(waiter.isNull())
+            {
+                continue;
+            }
+            if(!found)
+            {
+                emit waiter->resolveFailed(key.query);
+            }
+            else if(ZCONF_HOST_QUERY == key.kind)
+            {
+                emit waiter->hostNameResolved(key.query, value);
+            }
+            else
+            {
+                emit waiter->addressResolved(key.query, value);
+            }
+        }
+    }
+
+    static void hostCallback(AvahiHostNameResolver  * const resolver,
+                             AvahiIfIndex             const interface,
+                             AvahiProtocol            const protocol,
+                             AvahiResolverEvent       const event,
+                             const char             * const name,
+                             const AvahiAddress     * const address,
+                             AvahiLookupResultFlags   const flags,
+                             void                   * const userdata)
+    {
+        Q_UNUSED(resolver);
+        Q_UNUSED(interface);
+        Q_UNUSED(protocol);
+        Q_UNUSED(name);
+        Q_UNUSED(flags);
+        if(nullptr != userdata)
+        {
+            ZConfPendingQuery * const query = static_cast<ZConfPendingQuery *>(userdata);
+            if(AVAHI_RESOLVER_FOUND == event)
+            {
+                char addr[AVAHI_ADDRESS_STR_MAX];
+                avahi_address_snprint(addr, sizeof(addr), address);
+                query->cache->finish(query, true, QString::fromLocal8Bit(addr));
+            }
+            else
+            {
+                qDebug() << (QLatin1String("Failed to resolve host '") % query->key.query % QLatin1String("': ") % avahi_strerror(avahi_client_errno(query->cache->client->client)));
+                query->cache->finish(query, false, QString());
+            }
+        }
+    }
+
+    static void addressCallback(AvahiAddressResolver   * const resolver,
+                                AvahiIfIndex             const interface,
+                                AvahiProtocol            const protocol,
+                                AvahiResolverEvent       const event,
+                                const AvahiAddress     * const address,
+                                const char             * const name,
+                                AvahiLookupResultFlags   const flags,
+                                void                   * const userdata)
+    {
+        Q_UNUSED(resolver);
+        Q_UNUSED(interface);
+        Q_UNUSED(protocol);
+        Q_UNUSED(address);
+        Q_UNUSED(flags);
+        if(nullptr != userdata)
+        {
+            ZConfPendingQuery * const query = static_cast<ZConfPendingQuery *>(userdata);
+            if(AVAHI_RESOLVER_FOUND == event)
+            {
+                query->cache->finish(query, true, QString(name));
+            }
+            else
+            {
+                qDebug() << (QLatin1String("Failed to resolve address '") % query->key.query % QLatin1String("': ") % avahi_strerror(avahi_client_errno(query->cache->client->client)));
+                query->cache->finish(query, false, QString());
+            }
+        }
+    }
+
+    static thread_local ZConfHostCache * instance;
+
+    ZConfServiceClient                          * const client;
+    QElapsedTimer                                       clock;
+    QTimer                                              sweeper;
+    QHash<ZConfQueryKey, ZConfCachedResult>             cache;
+    QHash<ZConfQueryKey, ZConfPendingQuery *>           pending;
+};
+
+thread_local ZConfHostCache * ZConfHostCache::instance = nullptr;
+
+/*!
+    \class ZConfHostResolver
+
+    \brief Asynchronous host name and address lookups over mDNS.
+
+    resolveHostName() looks up the address of a host such as the
+    ZConfServiceEntry::host of a resolved service, and resolveAddress() does
+    the reverse lookup. Neither blocks; the result is reported through
+    hostNameResolved(), addressResolved() or resolveFailed().
+
+    Results are kept in a cache shared by all resolvers on the same thread
+    for cacheTimeToLive() milliseconds. A lookup that gets no answer from the
+    daemon within ten seconds, or is made while the daemon is unavailable,
+    fails. A lookup that can be answered from the
+    cache reports its result before the call returns. Concurrent lookups of
+    the same name or address are merged into a single query to the daemon.
+ */
+
+/*!
+    Creates a host resolver.
+ */
+ZConfHostResolver::ZConfHostResolver(QObject * const parent)
+    : QObject(parent)
+{ }
+
+/*!
+    Destroys the resolver. Lookups it started keep running for other
+    resolvers waiting on them, and their results are still cached.
+ */
+ZConfHostResolver::~ZConfHostResolver()
+{ }
+
+/*!
+    Looks up the address of \a hostName (e.g., "node17.local"). If \a proto is
+    ZCONF_IPV4 or ZCONF_IPV6, only addresses of that family are considered.
+ */
+void ZConfHostResolver::resolveHostName(const QString & hostName, Protocol proto)
+{
+    const ZConfQueryKey key = {ZCONF_HOST_QUERY, hostName.toLower(), convertProtocol(proto)};
+    ZConfHostCache * const cache = ZConfHostCache::local();
+    QString address;
+    if(cache->lookup(key, &address))
+    {
+        emit hostNameResolved(key.query, address);
+        return;
+    }
+    cache->request(key, this);
+}
+
+/*!
+    Looks up the host name of the IPv4 or IPv6 \a address.
+ */
+void ZConfHostResolver::resolveAddress(const QString & address)
+{
+    const ZConfQueryKey key = {ZCONF_ADDRESS_QUERY, address, AVAHI_PROTO_UNSPEC};
+    ZConfHostCache * const cache = ZConfHostCache::local();
+    QString hostName;
+    if(cache->lookup(key, &hostName))
+    {
+        emit addressResolved(address, hostName);
+        return;
+    }
+    cache->request(key, this);
+}
+
+/*!
+    Sets for how long, in milliseconds, results are cached. This applies to
+    results obtained after the call.
+ */
+void ZConfHostResolver::setCacheTimeToLive(int msec)
+{
+    timeToLive.store(msec);
+}
+
+/*!
+    Returns for how long, in milliseconds, results are cached.
+ */
+int ZConfHostResolver::cacheTimeToLive()
+{
+    return timeToLive.load();
+}
+
+/*!
+    Drops all cached results of the calling thread.
+ */
+void ZConfHostResolver::clearCache()
+{
+    ZConfHostCache::local()->clear();
+}
+
+/*!
+    \fn void ZConfHostResolver::hostNameResolved(const QString & hostName, const QString & address)
+
+    Emitted when \a hostName has been resolved to \a address. Host names are
+    reported in lower case.
+ */
+
+/*!
+    \fn void ZConfHostResolver::addressResolved(const QString & address, const QString & hostName)
+
+    Emitted when \a address has been resolved to \a hostName.
+ */
+
+/*!
+    \fn void ZConfHostResolver::resolveFailed(const QString & query)
+
+    Emitted when the host name or address \a query could not be resolved.
+ */
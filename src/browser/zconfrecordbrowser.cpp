@@ -0,0 +1,316 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <QDebug>
+#include <QStringBuilder>
+
+#include <arpa/inet.h>
+
+#include <avahi-common/error.h>
+
+#include "qtzeroconf/zconfserviceclient.h"
+#include "qtzeroconf/zconfrecordbrowser.h"
+
+/*!
+    \struct ZConfRecord
+
+    \brief A DNS resource record reported by ZConfRecordBrowser.
+
+    \a rdata refers directly to the buffer Avahi passed to the callback and is
+    only valid while recordAdded() or recordRemoved() is being emitted.
+    Receivers must be connected directly (not queued), and must copy the data
+    (e.g., with QByteArray(rdata.constData(), rdata.size())) or decode it with
+    one of the decode functions if they need it afterwards.
+ */
+
+/*!
+    Decodes the rdata of an A record into the textual IPv4 \a address.
+    Returns false if \a rdata is malformed.
+ */
+bool ZConfRecord::decodeA(const QByteArray & rdata, QString * const address)
+{
+    char text[INET_ADDRSTRLEN];
+    if(4 != rdata.size() || nullptr == inet_ntop(AF_INET, rdata.constData(), text, sizeof(text)))
+    {
+        return false;
+    }
+    *address = QString::fromLatin1(text);
+    return true;
+}
+
+/*!
+    Decodes the rdata of an AAAA record into the textual IPv6 \a address.
+    Returns false if \a rdata is malformed.
+ */
+bool ZConfRecord::decodeAAAA(const QByteArray & rdata, QString * const address)
+{
+    char text[INET6_ADDRSTRLEN];
+    if(16 != rdata.size() || nullptr == inet_ntop(AF_INET6, rdata.constData(), text, sizeof(text)))
+    {
+        return false;
+    }
+    *address = QString::fromLatin1(text);
+    return true;
+}
+
+namespace
+{
+    // Decodes an uncompressed domain name starting at offset. Avahi hands
+    // out rdata with name compression already undone.
+    static bool decodeDomainName(const QByteArray & rdata, int offset, QString * const name)
+    {
+        QString result;
+        while(offset < rdata.size())
+        {
+            const int length = static_cast<unsigned char>(rdata.at(offset++));
+            if(0 == length)
+            {
+                *name = result;
+                return true;
+            }
+            if(63 < length || rdata.size() < offset + length)
+            {
+                return false;
+            }
+            if(!result.isEmpty())
+            {
+                result += QLatin1Char('.');
+            }
+            result += QString::fromUtf8(rdata.constData() + offset, length);
+            offset += length;
+        }
+        return false;
+    }
+
+    static uint16_t readUInt16(const QByteArray & rdata, int const offset)
+    {
+        return (uint16_t(static_cast<unsigned char>(rdata.at(offset))) << 8)
+              | uint16_t(static_cast<unsigned char>(rdata.at(offset + 1)));
+    }
+}
+
+/*!
+    Decodes the rdata of a record holding a single domain name (PTR, CNAME
+    or NS). Returns false if \a rdata is malformed.
+ */
+bool ZConfRecord::decodeName(const QByteArray & rdata, QString * const name)
+{
+    return decodeDomainName(rdata, 0, name);
+}
+
+/*!
+    Decodes the rdata of an SRV record. Returns false if \a rdata is
+    malformed.
+ */
+bool ZConfRecord::decodeSRV(const QByteArray & rdata, ZConfSrvRecord * const srv)
+{
+    if(rdata.size() < 7)
+    {
+        return false;
+    }
+    srv->priority = readUInt16(rdata, 0);
+    srv->weight   = readUInt16(rdata, 2);
+    srv->port     = readUInt16(rdata, 4);
+    return decodeDomainName(rdata, 6, &srv->target);
+}
+
+/*!
+    Splits the rdata of a TXT record into its character strings. The strings
+    are copied, so they remain valid after the signal has returned. Returns
+    false if \a rdata is malformed.
+ */
+bool ZConfRecord::decodeTXT(const QByteArray & rdata, QList<QByteArray> * const strings)
+{
+    QList<QByteArray> result;
+    int offset = 0;
+    while(offset < rdata.size())
+    {
+        const int length = static_cast<unsigned char>(rdata.at(offset++));
+        if(rdata.size() < offset + length)
+        {
+            return false;
+        }
+        result.append(QByteArray(rdata.constData() + offset, length));
+        offset += length;
+    }
+    *strings = result;
+    return true;
+}
+
+class ZConfRecordBrowserPrivate
+{
+public:
+    ZConfRecordBrowserPrivate(ZConfRecordBrowser * const in_q)
+        : q(in_q)
+        , client(ZConfServiceClient::shared())
+    { }
+
+    static void callback(AvahiRecordBrowser     * const browser,
+                         AvahiIfIndex             const interface,
+                         AvahiProtocol            const protocol,
+                         AvahiBrowserEvent        const event,
+                         const char             * const name,
+                         uint16_t                 const clazz,
+                         uint16_t                 const type,
+                         const void             * const rdata,
+                         size_t                   const size,
+                         AvahiLookupResultFlags   const flags,
+                         void                   * const userdata)
+    {
+        Q_UNUSED(browser);
+        if(nullptr != userdata)
+        {
+            const ZConfRecordBrowser * const recordBrowser = static_cast<ZConfRecordBrowser *>(userdata);
+            switch(event)
+            {
+            case AVAHI_BROWSER_FAILURE:
+                qDebug() << (QLatin1String("Avahi record browser error: ") % QString(avahi_strerror(avahi_client_errno(recordBrowser->d_ptr->client->client))));
+                emit recordBrowser->recordBrowserFailure();
+                break;
+            case AVAHI_BROWSER_NEW:
+            case AVAHI_BROWSER_REMOVE:
+            {
+                const ZConfRecord record = {interface,
+                                            protocol,
+                                            QString(name),
+                                            clazz,
+                                            type,
+                                            QByteArray::fromRawData(static_cast<const char *>(rdata), int(size)),
+                                            flags};
+                if(AVAHI_BROWSER_NEW == event)
+                    emit recordBrowser->recordAdded(record);
+                else
+                    emit recordBrowser->recordRemoved(record);
+                break;
+            }
+            case AVAHI_BROWSER_ALL_FOR_NOW:
+                emit recordBrowser->allForNow();
+                break;
+            case AVAHI_BROWSER_CACHE_EXHAUSTED:
+                qDebug() << QLatin1String("AVAHI_BROWSER_CACHE_EXHAUSTED");
+            } // end switch
+        }
+    }
+
+    void start()
+    {
+        if(   (nullptr != browser)
+           || (nullptr == client->client)
+           || (AVAHI_CLIENT_S_RUNNING != avahi_client_get_state(client->client)))
+        {
+            return;
+        }
+        browser = avahi_record_browser_new(client->client,
+                                           AVAHI_IF_UNSPEC,
+                                           AVAHI_PROTO_UNSPEC,
+                                           name.toLocal8Bit().data(),
+                                           clazz,
+                                           type,
+                                           (AvahiLookupFlags) 0,
+                                           ZConfRecordBrowserPrivate::callback,
+                                           q);
+        if(nullptr == browser)
+        {
+            qDebug() << (QLatin1String("Failed to browse for record '") % name % QLatin1String("': ") % avahi_strerror(avahi_client_errno(client->client)));
+        }
+    }
+
+    ZConfRecordBrowser  * const q;
+    ZConfServiceClient  * const client;
+    AvahiRecordBrowser  *       browser = nullptr;
+    QString                     name;
+    uint16_t                    clazz = ZConfRecord::ZCONF_CLASS_IN;
+    uint16_t                    type  = 0;
+};
+
+/*!
+    \class ZConfRecordBrowser
+
+    \brief Browses for individual DNS resource records, such as the SRV or a
+    custom record of a device, without resolving whole services.
+
+    Call browse() with the record name, type and class. recordAdded() and
+    recordRemoved() are emitted as records come and go. The record data is
+    passed without copying (see ZConfRecord) and can be decoded with the
+    ZConfRecord decode functions. All record browsers on a thread share one
+    Avahi client.
+ */
+
+/*!
+    Creates a record browser. Call browse() to start browsing.
+ */
+ZConfRecordBrowser::ZConfRecordBrowser(QObject * const parent)
+    : QObject(parent),
+      d_ptr(new ZConfRecordBrowserPrivate(this))
+{
+    connect(d_ptr->client, &ZConfServiceClient::clientRunning, this, [this]()
+    {
+        this->d_ptr->start();
+    });
+}
+
+/*!
+    Destroys the browser object and releases all resources associated with it.
+ */
+ZConfRecordBrowser::~ZConfRecordBrowser()
+{
+    if(nullptr != d_ptr->browser)
+    {
+        avahi_record_browser_free(d_ptr->browser);
+    }
+    delete d_ptr;
+}
+
+/*!
+    Browses for records named \a name (e.g., "node17.local" or
+    "printer._ipp._tcp.local") of the given \a type and \a clazz. This is a
+    non-blocking call. Browsing starts as soon as the Avahi client is running.
+ */
+void ZConfRecordBrowser::browse(const QString & name, uint16_t type, uint16_t clazz)
+{
+    if(nullptr != d_ptr->browser)
+    {
+        avahi_record_browser_free(d_ptr->browser);
+        d_ptr->browser = nullptr;
+    }
+    d_ptr->name  = name;
+    d_ptr->type  = type;
+    d_ptr->clazz = clazz;
+    d_ptr->start();
+}
+
+/*!
+    \fn void ZConfRecordBrowser::recordAdded(const ZConfRecord & record)
+
+    Emitted when \a record appears on the network. The record data is only
+    valid during the emission.
+ */
+
+/*!
+    \fn void ZConfRecordBrowser::recordRemoved(const ZConfRecord & record)
+
+    Emitted when \a record is removed from the network. The record data is
+    only valid during the emission.
+ */
+
+/*!
+    \fn void ZConfRecordBrowser::allForNow()
+
+    Emitted when the daemon has reported all records currently known.
+ */
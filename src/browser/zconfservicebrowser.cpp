@@ -19,15 +19,22 @@
 
 #include <QDebug>
 
+#include <QElapsedTimer>
+#include <QFutureInterface>
 #include <QHash>
+#include <QSet>
 #include <QStringBuilder>
+#include <QTimer>
+#include <QVector>
 
 #include <cassert>
 
 #include <avahi-common/error.h>
 
+#include "qtzeroconf/zconflocalregistry.h"
 #include "qtzeroconf/zconfserviceclient.h"
 #include "qtzeroconf/zconfservicebrowser.h"
+#include "qtzeroconf/zconftrace.h"
 
 /*!
     \struct ZConfServiceEntry
@@ -106,12 +113,107 @@ QString ZConfServiceEntry::protocolName() const
     Returns true if this service resides on and was announced by the local host.
  */
 
+/*!
+    Returns the set of fields that differ between this entry and \a other.
+    The AVAHI_LOOKUP_RESULT_CACHED bit is ignored when comparing flags, since
+    it only tells where a response came from and not what it contains.
+ */
+ZConfServiceEntry::Fields ZConfServiceEntry::changedFields(const ZConfServiceEntry & other) const
+{
+    Fields changed = NoFields;
+    if(interface != other.interface)
+        changed |= InterfaceField;
+    if(ip != other.ip)
+        changed |= IpField;
+    if(domain != other.domain)
+        changed |= DomainField;
+    if(type != other.type)
+        changed |= TypeField;
+    if(host != other.host)
+        changed |= HostField;
+    if(port != other.port)
+        changed |= PortField;
+    if(protocol != other.protocol)
+        changed |= ProtocolField;
+    if((flags & ~AVAHI_LOOKUP_RESULT_CACHED) != (other.flags & ~AVAHI_LOOKUP_RESULT_CACHED))
+        changed |= FlagsField;
+    if(TXTRecords != other.TXTRecords)
+        changed |= TXTRecordsField;
+    return changed;
+}
+
+namespace
+{
+    struct ZConfResolverKey
+    {
+        QString       name;
+        QString       domain;
+        AvahiIfIndex  interface;
+        AvahiProtocol protocol;
+    };
+
+    inline bool operator==(const ZConfResolverKey & a, const ZConfResolverKey & b)
+    {
+        return (   (a.interface == b.interface)
+                && (a.protocol  == b.protocol)
+                && (a.name      == b.name)
+                && (a.domain    == b.domain));
+    }
+
+    inline uint qHash(const ZConfResolverKey & key, uint seed = 0)
+    {
+        return ::qHash(key.name, seed) ^ ::qHash(key.domain, seed) ^ uint(key.interface) ^ (uint(key.protocol) << 16);
+    }
+
+    static QStringMap parseTXTRecords(const QList<QByteArray> & records)
+    {
+        QStringMap returnMap;
+        for(const QByteArray & txt : records)
+        {
+            static const QLatin1Char equals('=');
+            const QString &txtstr = QString::fromLocal8Bit(txt.constData(), txt.size());
+            int equalspos = txtstr.indexOf(equals);
+            // A key without "=" is a boolean attribute (RFC 6763, section
+            // 6.4) and has no value, as in ZConfTxtRecord::toMap().
+            if(0 > equalspos)
+            {
+                returnMap.insert(txtstr, QString());
+                continue;
+            }
+            returnMap.insert(txtstr.left(equalspos), txtstr.right(txtstr.length() - equalspos - 1));
+        }
+        return returnMap;
+    }
+}
+
+namespace
+{
+    // Every resolver started by a browser has one of these, owned by the
+    // browser's resolver table and passed to Avahi as userdata. Resolvers
+    // are always freed together with their record, so Avahi never calls back
+    // with a stale pointer.
+    struct ZConfResolverRecord
+    {
+        ZConfServiceBrowserPrivate * d;
+        ZConfResolverKey             key;
+        AvahiServiceResolver       * resolver;
+        QElapsedTimer                started;
+        bool                         resolved;
+    };
+}
+
 class ZConfServiceBrowserPrivate
 {
 public:
-    ZConfServiceBrowserPrivate(ZConfServiceClient * const in_client)
-        : client(in_client)
-    { }
+    ZConfServiceBrowserPrivate(ZConfServiceBrowser * const in_q, ZConfServiceClient * const in_client)
+        : q(in_q)
+        , client(in_client)
+    {
+        QObject::connect(&sweeper, &QTimer::timeout, [this]()
+        {
+            expireResolvers();
+        });
+    }
 
     static void callback(AvahiServiceBrowser    * const browser,
                          AvahiIfIndex             const interface,
@@ -122,51 +224,223 @@ public:
                          const char             * const domain,
                          AvahiLookupResultFlags   const flags,
                          void                   * const userdata)
+    {
+        if(nullptr != userdata)
+        {
+            const ZConfServiceBrowser * const serviceBrowser = static_cast<ZConfServiceBrowser *>(userdata);
+            ZConfServiceBrowserPrivate * const d = serviceBrowser->d_ptr;
+            const ZConfBrowserEvent in_event{d->type,
+                                             d->browsers.key(browser),
+                                             interface,
+                                             protocol,
+                                             event,
+                                             QString(name),
+                                             QString(type),
+                                             QString(domain),
+                                             flags,
+                                             AVAHI_BROWSER_FAILURE == event ? avahi_client_errno(d->client->client) : 0};
+            if(ZConfTrace::isRecording())
+            {
+                ZConfTrace::recordBrowserEvent(in_event);
+            }
+            d->browserEvent(in_event);
+        }
+    }
+
+    void browserEvent(const ZConfBrowserEvent & event)
+    {
+        switch(event.event)
+        {
+        case AVAHI_BROWSER_FAILURE:
+            qDebug() << (QLatin1String("Avahi browser error: ") % QString(avahi_strerror(event.error)));
+            emit q->serviceBrowserFailure();
+            // The failed browser reports nothing more, but the other domains
+            // can still complete.
+            browserAllForNow(event.browsedDomain);
+            break;
+        case AVAHI_BROWSER_NEW:
+            qDebug() << (QLatin1String("New service '") % event.name % QLatin1String("' of type ") % event.type % QLatin1String(" in domain ") % event.domain % QLatin1String(" on protocol ") % protocolStringName(event.protocol) % QLatin1String("."));
+            instanceAdded({event.name, event.domain, event.interface, event.protocol});
+            break;
+        case AVAHI_BROWSER_REMOVE:
+            qDebug() << QLatin1String("Service '") % event.name % QLatin1String("' removed from the network.");
+            instanceRemoved({event.name, event.domain, event.interface, event.protocol});
+            break;
+        case AVAHI_BROWSER_ALL_FOR_NOW:
+        case AVAHI_BROWSER_CACHE_EXHAUSTED:
+            qDebug() << (AVAHI_BROWSER_ALL_FOR_NOW == event.event
+                         ? QLatin1String("AVAHI_BROWSER_ALL_FOR_NOW")
+                         : QLatin1String("AVAHI_BROWSER_CACHE_EXHAUSTED"));
+            if(AVAHI_BROWSER_ALL_FOR_NOW == event.event)
+            {
+                browserAllForNow(event.browsedDomain);
+            }
+        } // end switch
+    }
+
+    static void domainCallback(AvahiDomainBrowser     * const browser,
+                               AvahiIfIndex             const interface,
+                               AvahiProtocol            const protocol,
+                               AvahiBrowserEvent        const event,
+                               const char             * const domain,
+                               AvahiLookupResultFlags   const flags,
+                               void                   * const userdata)
     {
         Q_UNUSED(browser);
+        Q_UNUSED(interface);
+        Q_UNUSED(protocol);
         Q_UNUSED(flags);
         if(nullptr != userdata)
         {
-            const QString in_name(name);
+            const QString in_domain(domain);
             const ZConfServiceBrowser * const serviceBrowser = static_cast<ZConfServiceBrowser *>(userdata);
+            ZConfServiceBrowserPrivate * const d = serviceBrowser->d_ptr;
             switch(event)
             {
             case AVAHI_BROWSER_FAILURE:
-                qDebug() << (QLatin1String("Avahi browser error: ") % QString(avahi_strerror(avahi_client_errno(serviceBrowser->d_ptr->client->client))));
+                qDebug() << (QLatin1String("Avahi domain browser error: ") % QString(avahi_strerror(avahi_client_errno(d->client->client))));
                 break;
             case AVAHI_BROWSER_NEW:
-                qDebug() << (QLatin1String("New service '") % in_name % QLatin1String("' of type ") % QString(type) % QLatin1String(" in domain ") % QString(domain) % QLatin1String(" on protocol ") % protocolStringName(protocol) % QLatin1String("."));
-
-                // We ignore the returned resolver object. In the callback
-                // function we free it. If the server is terminated before
-                // the callback function is called the server will free
-                // the resolver for us.
-                if (!(avahi_service_resolver_new(serviceBrowser->d_ptr->client->client,
-                                                 interface,
-                                                 protocol,
-                                                 name,
-                                                 serviceBrowser->d_ptr->type.toLocal8Bit().data(),
-                                                 domain,
-                                                 AVAHI_PROTO_UNSPEC,
-                                                 (AvahiLookupFlags) 0,
-                                                 ZConfServiceBrowserPrivate::resolve,
-                                                 const_cast<ZConfServiceBrowser * const>(serviceBrowser))))
-                    qDebug() << (QLatin1String("Failed to resolve service '") % in_name % QLatin1String("': ") % avahi_strerror(avahi_client_errno(serviceBrowser->d_ptr->client->client)));
+                // Domains are reported once per interface and protocol.
+                if(0 == d->enumerated[in_domain]++)
+                {
+                    qDebug() << (QLatin1String("New browse domain '") % in_domain % QLatin1String("'."));
+                    emit serviceBrowser->domainAdded(in_domain);
+                    if(!d->domains.contains(in_domain) && !d->isDefaultDomain(in_domain))
+                    {
+                        d->discovered.insert(in_domain);
+                        d->domains.append(in_domain);
+                        d->startBrowser(in_domain);
+                    }
+                }
                 break;
             case AVAHI_BROWSER_REMOVE:
-                emit serviceBrowser->serviceEntryRemoved(in_name);
-                serviceBrowser->d_ptr->entries.remove(in_name);
-                qDebug() << QLatin1String("Service '") % in_name % QLatin1String("' removed from the network.");
+                if(d->enumerated.contains(in_domain) && 0 == --d->enumerated[in_domain])
+                {
+                    qDebug() << (QLatin1String("Browse domain '") % in_domain % QLatin1String("' removed."));
+                    d->enumerated.remove(in_domain);
+                    if(d->discovered.contains(in_domain))
+                    {
+                        d->removeDomain(in_domain);
+                    }
+                    emit serviceBrowser->domainRemoved(in_domain);
+                }
                 break;
             case AVAHI_BROWSER_ALL_FOR_NOW:
             case AVAHI_BROWSER_CACHE_EXHAUSTED:
-                qDebug() << (AVAHI_BROWSER_ALL_FOR_NOW == event
-                             ? QLatin1String("AVAHI_BROWSER_ALL_FOR_NOW")
-                             : QLatin1String("AVAHI_BROWSER_CACHE_EXHAUSTED"));
+                break;
             } // end switch
         }
     }
 
+    bool isRunning() const
+    {
+        return (   (nullptr != client->client)
+                && (AVAHI_CLIENT_S_RUNNING == avahi_client_get_state(client->client)));
+    }
+
+    // The default domain is browsed by passing no domain at all, which is
+    // stored as an empty string.
+    bool isDefaultDomain(const QString & domain) const
+    {
+        return domains.contains(QString()) && isRunning() && domain == QString(avahi_client_get_domain_name(client->client));
+    }
+
+    void startBrowsers()
+    {
+        if(replaying || !isRunning() || type.isEmpty())
+        {
+            return;
+        }
+        for(const QString & domain : domains)
+        {
+            startBrowser(domain);
+        }
+        if(enumerateDomains && nullptr == domainBrowser)
+        {
+            domainBrowser = avahi_domain_browser_new(client->client,
+                                                     AVAHI_IF_UNSPEC,
+                                                     AVAHI_PROTO_UNSPEC,
+                                                     nullptr,
+                                                     AVAHI_DOMAIN_BROWSER_BROWSE,
+                                                     (AvahiLookupFlags) 0,
+                                                     ZConfServiceBrowserPrivate::domainCallback,
+                                                     q);
+            if(nullptr == domainBrowser)
+            {
+                qDebug() << (QLatin1String("Failed to enumerate browse domains: ") % avahi_strerror(avahi_client_errno(client->client)));
+            }
+        }
+    }
+
+    void startBrowser(const QString & domain)
+    {
+        if(replaying || !isRunning() || type.isEmpty() || browsers.contains(domain))
+        {
+            return;
+        }
+        const QByteArray domainName = domain.toLocal8Bit();
+        AvahiServiceBrowser * const browser = avahi_service_browser_new(client->client,
+                                                                        AVAHI_IF_UNSPEC,
+                                                                        proto,
+                                                                        type.toLocal8Bit().data(),
+                                                                        domain.isEmpty() ? nullptr : domainName.data(),
+                                                                        (AvahiLookupFlags) 0,
+                                                                        ZConfServiceBrowserPrivate::callback,
+                                                                        q);
+        if(nullptr == browser)
+        {
+            qDebug() << (QLatin1String("Failed to browse domain '") % domain % QLatin1String("': ") % avahi_strerror(avahi_client_errno(client->client)));
+            return;
+        }
+        browsers.insert(domain, browser);
+        browsing.insert(domain);
+    }
+
+    // Stops browsing the domain and drops every service found in it.
+    void removeDomain(const QString & domain)
+    {
+        domains.removeAll(domain);
+        discovered.remove(domain);
+        browsing.remove(domain);
+        AvahiServiceBrowser * const browser = browsers.take(domain);
+        if(nullptr != browser)
+        {
+            avahi_service_browser_free(browser);
+        }
+
+        const QString actual = (domain.isEmpty() && isRunning())
+                             ? QString(avahi_client_get_domain_name(client->client))
+                             : domain;
+        for(const ZConfResolverKey & key : queued.take(actual))
+        {
+            queuedKeys.remove(key);
+        }
+
+        QList<ZConfResolverKey> gone;
+        for(const ZConfResolverKey & key : instances)
+        {
+            if(actual == key.domain)
+            {
+                gone.append(key);
+            }
+        }
+        for(const ZConfResolverKey & key : gone)
+        {
+            instanceRemoved(key);
+        }
+    }
+
+    void browserAllForNow(const QString & domain)
+    {
+        browsing.remove(domain);
+        if(browsing.isEmpty())
+        {
+            allForNow = true;
+            checkAllForNow();
+        }
+    }
+
     static void resolve(AvahiServiceResolver   * const resolver,
                         AvahiIfIndex             const interface,
                         AvahiProtocol            const protocol,
@@ -181,55 +455,602 @@ public:
                         AvahiLookupResultFlags   const flags,
                         void                   * const userdata)
     {
-        static char addr[AVAHI_ADDRESS_STR_MAX];
-        if(nullptr != userdata)
+        Q_UNUSED(resolver);
+        static char addr[AVAHI_ADDRESS_STR_MAX];
+        if(nullptr != userdata)
+        {
+            ZConfResolverRecord        * const record = static_cast<ZConfResolverRecord *>(userdata);
+            ZConfServiceBrowserPrivate * const d      = record->d;
+            const bool found = (AVAHI_RESOLVER_FOUND == event);
+            if(found)
+            {
+                avahi_address_snprint(addr, sizeof(addr), address);
+            }
+            const ZConfResolverEvent in_event{d->type,
+                                              interface,
+                                              protocol,
+                                              event,
+                                              QString(name),
+                                              QString(type),
+                                              QString(domain),
+                                              found ? QString(host_name) : QString(),
+                                              found ? QString::fromLocal8Bit(addr) : QString(),
+                                              port,
+                                              ({
+                                                  // The strings are only borrowed for the
+                                                  // duration of the callback.
+                                                  QList<QByteArray> records;
+                                                  for(; nullptr != txt; txt = txt->next)
+                                                  {
+                                                      records.append(QByteArray::fromRawData(reinterpret_cast<const char *>(txt->text), int(txt->size)));
+                                                  }
+                                                  records;
+                                              }),
+                                              flags,
+                                              found ? 0 : avahi_client_errno(d->client->client)};
+            if(ZConfTrace::isRecording())
+            {
+                ZConfTrace::recordResolverEvent(in_event);
+            }
+            d->resolverEvent(record, in_event);
+        }
+    }
+
+    void resolverEvent(ZConfResolverRecord * const record, const ZConfResolverEvent & event)
+    {
+        switch(event.event)
+        {
+            case AVAHI_RESOLVER_FAILURE:
+            {
+                qDebug() << (QLatin1String("Failed to resolve service '") % event.name % QLatin1String("': ") % avahi_strerror(event.error));
+                finishResolver(record, false);
+                checkAllForNow();
+                if(AVAHI_ERR_TIMEOUT == event.error)
+                {
+                    emit q->serviceResolveTimeout(event.name);
+                }
+                break;
+            }
+            case AVAHI_RESOLVER_FOUND:
+            {
+                const ZConfResolverKey  key = record->key;
+                const ZConfServiceEntry entry{event.interface,
+                                              event.address,
+                                              event.domain,
+                                              event.type,
+                                              event.host,
+                                              event.port,
+                                              event.protocol,
+                                              event.flags,
+                                              parseTXTRecords(event.TXTRecords)};
+
+                // A watched resolver stays alive and reports again
+                // whenever the address, port or TXT data changes. The
+                // record is done with before any signal is emitted, since
+                // a connected slot may cancel the resolver and free it.
+                finishResolver(record, watch);
+                instanceResolved(key, entry);
+                checkAllForNow();
+            }
+        }
+    }
+
+    // A resolver event read from a trace. The resolver is looked up by its
+    // key; an announcement still waiting in the queue is started first, as
+    // it must have been when the trace was recorded.
+    void replayedResolverEvent(const ZConfResolverEvent & event)
+    {
+        const ZConfResolverKey key{event.name, event.domain, event.interface, event.protocol};
+        if(   !resolvers.contains(key)
+           && instances.contains(key)
+           && owner.value(key.name) == key.domain)
+        {
+            queuedKeys.remove(key);
+            startResolver(key);
+        }
+        ZConfResolverRecord * const record = resolvers.value(key);
+        if(nullptr != record)
+        {
+            resolverEvent(record, event);
+        }
+    }
+
+    // A service is announced once per interface and protocol. The entry
+    // exists for as long as at least one of these instances does.
+    //
+    // Entries are keyed by name, so a name can only belong to one domain at
+    // a time: the domain it was first announced in. Instances in other
+    // domains are kept track of, but not resolved, until that domain no
+    // longer has the service.
+    void instanceAdded(const ZConfResolverKey & key)
+    {
+        if(!instances.contains(key))
+        {
+            instances.insert(key);
+            instancesOf[key.name].insert(key);
+        }
+        QHash<QString, QString>::const_iterator owned = owner.constFind(key.name);
+        if(owner.constEnd() == owned)
+        {
+            owner.insert(key.name, key.domain);
+        }
+        else if(*owned != key.domain)
+        {
+            qDebug() << (QLatin1String("Ignoring service '") % key.name % QLatin1String("' in domain ") % key.domain % QLatin1String(", it was already found in domain ") % *owned % QLatin1String("."));
+            return;
+        }
+        requestResolve(key);
+    }
+
+    void requestResolve(const ZConfResolverKey & key)
+    {
+        if(resolvers.contains(key) || queuedKeys.contains(key))
+        {
+            return;
+        }
+
+        // Resolves are limited per domain, so that a large site domain
+        // cannot starve the others.
+        if(0 < maxConcurrentResolves && maxConcurrentResolves <= domainInFlight.value(key.domain))
+        {
+            queued[key.domain].append(key);
+            queuedKeys.insert(key);
+            return;
+        }
+        startResolver(key);
+    }
+
+    void startResolver(const ZConfResolverKey & key)
+    {
+        ZConfResolverRecord * const record = new ZConfResolverRecord{this, key, nullptr, QElapsedTimer(), false};
+        // When replaying a trace, the results come from the trace and no
+        // resolver is needed.
+        record->resolver = replaying ? nullptr : avahi_service_resolver_new(client->client,
+                                                      key.interface,
+                                                      key.protocol,
+                                                      key.name.toLocal8Bit().data(),
+                                                      type.toLocal8Bit().data(),
+                                                      key.domain.toLocal8Bit().data(),
+                                                      AVAHI_PROTO_UNSPEC,
+                                                      (AvahiLookupFlags) 0,
+                                                      ZConfServiceBrowserPrivate::resolve,
+                                                      record);
+        if(!replaying && nullptr == record->resolver)
+        {
+            qDebug() << (QLatin1String("Failed to resolve service '") % key.name % QLatin1String("': ") % avahi_strerror(avahi_client_errno(client->client)));
+            delete record;
+            return;
+        }
+
+        record->started.start();
+        resolvers.insert(key, record);
+        ++inFlight;
+        ++domainInFlight[key.domain];
+        if(0 < resolveTimeout && !sweeper.isActive())
+        {
+            sweeper.start(qMin(resolveTimeout, 1000));
+        }
+    }
+
+    // Keys that leave the queue early are only removed from queuedKeys;
+    // their stale copies in the domain's list are skipped here.
+    void startQueued(const QString & domain)
+    {
+        QHash<QString, QList<ZConfResolverKey> >::iterator it = queued.find(domain);
+        while(   (queued.end() != it)
+              && !it->isEmpty()
+              && (0 >= maxConcurrentResolves || domainInFlight.value(domain) < maxConcurrentResolves))
+        {
+            const ZConfResolverKey key = it->takeFirst();
+            if(queuedKeys.remove(key))
+            {
+                startResolver(key);
+            }
+        }
+        if(queued.end() != it && it->isEmpty())
+        {
+            queued.erase(it);
+        }
+    }
+
+    void instanceRemoved(const ZConfResolverKey & key)
+    {
+        queuedKeys.remove(key);
+        cancelResolver(key);
+        if(!instances.remove(key))
+        {
+            return;
+        }
+        resolved.remove(key);
+
+        QHash<QString, QSet<ZConfResolverKey> >::iterator named = instancesOf.find(key.name);
+        named->remove(key);
+        if(named->isEmpty())
+        {
+            instancesOf.erase(named);
+            owner.remove(key.name);
+            canonical.remove(key.name);
+            // An entry the daemon has not resolved yet still belongs to the
+            // local registry.
+            if(!localNames.contains(key.name))
+            {
+                removeEntry(key.name);
+            }
+            return;
+        }
+
+        if(owner.value(key.name) != key.domain)
+        {
+            return;
+        }
+
+        // Once its domain no longer has the service, the name passes on to
+        // another domain that announced it.
+        QList<ZConfResolverKey> others;
+        for(const ZConfResolverKey & other : *named)
+        {
+            if(key.domain == other.domain)
+            {
+                others.clear();
+                break;
+            }
+            others.append(other);
+        }
+        if(!others.isEmpty())
+        {
+            const QString domain = others.first().domain;
+            owner.insert(key.name, domain);
+            canonical.remove(key.name);
+            if(!localNames.contains(key.name))
+            {
+                removeEntry(key.name);
+            }
+            for(const ZConfResolverKey & other : others)
+            {
+                if(domain == other.domain && instances.contains(other))
+                {
+                    requestResolve(other);
+                }
+            }
+            return;
+        }
+
+        // The entry follows another resolved instance, if there is one.
+        // Otherwise it keeps its data until the next instance resolves.
+        QHash<QString, ZConfResolverKey>::iterator it = canonical.find(key.name);
+        if(canonical.end() != it && *it == key)
+        {
+            canonical.erase(it);
+            for(const ZConfResolverKey & other : *named)
+            {
+                if(resolved.contains(other))
+                {
+                    instanceResolved(other, resolved.value(other));
+                    break;
+                }
+            }
+        }
+    }
+
+    // Every instance keeps its own resolved data. The entry of the service
+    // is that of one canonical instance, the first one resolved, so that
+    // instances on other interfaces or protocols, which naturally differ in
+    // address, interface and protocol, are not reported as updates.
+    void instanceResolved(const ZConfResolverKey & key, const ZConfServiceEntry & entry)
+    {
+        resolved.insert(key, entry);
+        QHash<QString, ZConfResolverKey>::const_iterator it = canonical.constFind(key.name);
+        if(canonical.constEnd() == it)
+        {
+            canonical.insert(key.name, key);
+        }
+        else if(!(*it == key))
+        {
+            return;
+        }
+        // The interface, address, protocol and flags of an entry taken from
+        // the local registry are only stand-ins until the daemon reports the
+        // service, so replacing them is not a change.
+        if(localNames.remove(key.name))
+        {
+            insertEntry(key.name, entry, ZConfServiceEntry::InterfaceField
+                                       | ZConfServiceEntry::IpField
+                                       | ZConfServiceEntry::ProtocolField
+                                       | ZConfServiceEntry::FlagsField);
+            return;
+        }
+        insertEntry(key.name, entry);
+    }
+
+    // Marks the record's resolve as complete. Unless the resolver is kept
+    // to watch for changes, it is freed along with its record. Callers
+    // check for allForNow() once they have reported the result.
+    void finishResolver(ZConfResolverRecord * const record, bool const keep)
+    {
+        const QString domain = record->key.domain;
+        bool const started = !record->resolved;
+        if(started)
+        {
+            record->resolved = true;
+            --inFlight;
+            --domainInFlight[domain];
+        }
+        if(!keep)
+        {
+            resolvers.remove(record->key);
+            if(nullptr != record->resolver)
+            {
+                avahi_service_resolver_free(record->resolver);
+            }
+            delete record;
+        }
+        if(started)
+        {
+            startQueued(domain);
+        }
+    }
+
+    void cancelResolver(const ZConfResolverKey & key)
+    {
+        ZConfResolverRecord * const record = resolvers.value(key);
+        if(nullptr != record)
+        {
+            finishResolver(record, false);
+            checkAllForNow();
+        }
+    }
+
+    void cancelAll()
+    {
+        for(ZConfResolverRecord * const record : resolvers)
+        {
+            if(nullptr != record->resolver)
+            {
+                avahi_service_resolver_free(record->resolver);
+            }
+            delete record;
+        }
+        resolvers.clear();
+        queued.clear();
+        queuedKeys.clear();
+        domainInFlight.clear();
+        inFlight = 0;
+        sweeper.stop();
+    }
+
+    void stopBrowsers()
+    {
+        if(nullptr != domainBrowser)
+        {
+            avahi_domain_browser_free(domainBrowser);
+            domainBrowser = nullptr;
+        }
+        for(AvahiServiceBrowser * const browser : browsers)
+        {
+            avahi_service_browser_free(browser);
+        }
+        browsers.clear();
+        browsing.clear();
+    }
+
+    // Starts a resolver for every instance that has none, so that services
+    // resolved before watching was enabled are watched too. In a replay the
+    // trace decides when resolvers report, so nothing is started.
+    void startWatchers()
+    {
+        if(replaying)
+        {
+            return;
+        }
+        for(const ZConfResolverKey & key : instances.values())
+        {
+            if(owner.value(key.name) == key.domain && instances.contains(key))
+            {
+                requestResolve(key);
+            }
+        }
+    }
+
+    void releaseWatchers()
+    {
+        QList<ZConfResolverKey> watched;
+        for(const ZConfResolverRecord * const record : resolvers)
+        {
+            if(record->resolved)
+            {
+                watched.append(record->key);
+            }
+        }
+        for(const ZConfResolverKey & key : watched)
+        {
+            cancelResolver(key);
+        }
+    }
+
+    // Gives up on resolves that have been in flight for longer than the
+    // resolve timeout.
+    void expireResolvers()
+    {
+        QList<ZConfResolverKey> expired;
+        for(const ZConfResolverRecord * const record : resolvers)
+        {
+            if(!record->resolved && 0 < resolveTimeout && record->started.hasExpired(resolveTimeout))
+            {
+                expired.append(record->key);
+            }
+        }
+        for(const ZConfResolverKey & key : expired)
+        {
+            qDebug() << (QLatin1String("Resolving service '") % key.name % QLatin1String("' timed out."));
+            cancelResolver(key);
+            emit q->serviceResolveTimeout(key.name);
+        }
+        if(0 == inFlight || 0 >= resolveTimeout)
+        {
+            sweeper.stop();
+        }
+    }
+
+    // Fields in \a ignored are replaced without being reported as changed.
+    void insertEntry(const QString & name, const ZConfServiceEntry & entry, ZConfServiceEntry::Fields const ignored = ZConfServiceEntry::NoFields)
+    {
+        ZConfServiceEntryTable::iterator it = entries.find(name);
+        if(entries.end() == it)
+        {
+            entries.insert(name, entry);
+            recordChange(ZConfServiceChange::ZCONF_ADDED, name, ZConfServiceEntry::NoFields);
+            emit q->serviceEntryAdded(name);
+            return;
+        }
+
+        const ZConfServiceEntry::Fields changed = it->changedFields(entry);
+        if(changed)
+        {
+            *it = entry;
+        }
+        if(changed & ~ignored)
+        {
+            recordChange(ZConfServiceChange::ZCONF_UPDATED, name, changed & ~ignored);
+            emit q->serviceEntryUpdated(name, changed & ~ignored);
+        }
+    }
+
+    // Once the daemon has reported AVAHI_BROWSER_ALL_FOR_NOW and no
+    // resolves are outstanding, the result set is complete for the time
+    // being.
+    void checkAllForNow()
+    {
+        if(allForNow && 0 == inFlight && queuedKeys.isEmpty())
+        {
+            allForNow = false;
+            emit q->allForNow();
+        }
+    }
+
+    void removeEntry(const QString & name)
+    {
+        if(!entries.contains(name))
+        {
+            return;
+        }
+        recordChange(ZConfServiceChange::ZCONF_REMOVED, name, ZConfServiceEntry::NoFields);
+        emit q->serviceEntryRemoved(name);
+        entries.remove(name);
+    }
+
+    // Every change of the entry table gets the next sequence number and is
+    // kept in a ring buffer, so that consumers can catch up on what they
+    // missed with changesSince().
+    void recordChange(ZConfServiceChange::Kind const kind, const QString & name, ZConfServiceEntry::Fields const fields)
+    {
+        ++sequence;
+        const int capacity = changeLog.size();
+        if(0 == capacity)
+        {
+            return;
+        }
+        if(changeCount < capacity)
+        {
+            changeLog[(changeHead + changeCount++) % capacity] = {sequence, kind, name, fields};
+        }
+        else
+        {
+            changeLog[changeHead] = {sequence, kind, name, fields};
+            changeHead = (changeHead + 1) % capacity;
+        }
+    }
+
+    // Services published by this process are taken from the local registry
+    // without a resolve. If the daemon has already reported the service, its
+    // result is kept; otherwise the daemon's result replaces the local entry
+    // once it arrives. Entries still waiting for the daemon are tracked in
+    // localNames. Changed TXT records are applied to either kind of entry,
+    // so they are reported as an update right away.
+    void insertLocal(const QString & serviceType, const QString & name)
+    {
+        ZConfLocalService service;
+        if(   !localFastPath
+           || (serviceType != type)
+           || !ZConfLocalRegistry::instance()->service(serviceType, name, &service))
+        {
+            return;
+        }
+        if(   (AVAHI_PROTO_UNSPEC != proto)
+           && (AVAHI_PROTO_UNSPEC != service.protocol)
+           && (proto != service.protocol))
+        {
+            return;
+        }
+        const ZConfServiceEntryTable::const_iterator it = entries.constFind(name);
+        if(entries.constEnd() != it && !localNames.contains(name))
+        {
+            ZConfServiceEntry entry = *it;
+            entry.TXTRecords = service.TXTRecords;
+            insertEntry(name, entry);
+            return;
+        }
+        if(service.address.isEmpty())
+        {
+            return;
+        }
+        localNames.insert(name);
+        insertEntry(name, {AVAHI_IF_UNSPEC,
+                           service.address,
+                           service.domain,
+                           service.type,
+                           service.host,
+                           service.port,
+                           service.protocol,
+                           AVAHI_LOOKUP_RESULT_LOCAL,
+                           service.TXTRecords});
+    }
+
+    void removeLocal(const QString & serviceType, const QString & name)
+    {
+        if(serviceType == type && localNames.remove(name))
         {
-            const QString in_name(name);
-            const ZConfServiceBrowser * const serviceBrowser = static_cast<ZConfServiceBrowser *>(userdata);
-            switch (event)
-            {
-                case AVAHI_RESOLVER_FAILURE:
-                    qDebug() << (QLatin1String("Failed to resolve service '") % in_name % QLatin1String("': ") % avahi_strerror(avahi_client_errno(serviceBrowser->d_ptr->client->client)));
-                    break;
-                case AVAHI_RESOLVER_FOUND:
-                {
-
-                    avahi_address_snprint(addr, sizeof(addr), address);
-                    serviceBrowser->d_ptr->entries.insert(in_name, {interface,
-                                                                    QString::fromLocal8Bit(addr),
-                                                                    QString(domain),
-                                                                    QString(type),
-                                                                    QString(host_name),
-                                                                    port,
-                                                                    protocol,
-                                                                    flags,
-                                                                    ({
-                                                                        QStringMap returnMap;
-                                                                        while(nullptr != txt)
-                                                                        {
-                                                                            static const QLatin1Char equals('=');
-                                                                            const QString &txtstr = QString::fromLocal8Bit(reinterpret_cast<const char*>(&(txt->text[0])),
-                                                                                                                           txt->size);
-                                                                            int equalspos = txtstr.indexOf(equals);
-                                                                            returnMap.insert(txtstr.left(equalspos), txtstr.right(txtstr.length() - equalspos - 1));
-                                                                            txt = txt->next;
-                                                                        }
-                                                                        returnMap;
-                                                                    })});
-                    emit serviceBrowser->serviceEntryAdded(in_name);
-                }
-            }
-            avahi_service_resolver_free(resolver);
+            removeEntry(name);
         }
     }
 
-    typedef QHash<QString, ZConfServiceEntry> ZConfServiceEntryTable;
+    typedef QHash<ZConfResolverKey, ZConfResolverRecord *> ZConfResolverTable;
+
+    typedef QHash<QString, AvahiServiceBrowser *> ZConfBrowserTable;
 
+    ZConfServiceBrowser    * const q;
     ZConfServiceClient     * const client;
-    AvahiServiceBrowser    *       browser = nullptr;
+    ZConfBrowserTable              browsers;
+    AvahiDomainBrowser     *       domainBrowser = nullptr;
+    QStringList                    domains = QStringList(QString());
+    QSet<QString>                  discovered;
+    QSet<QString>                  browsing;
+    QHash<QString, int>            enumerated;
     ZConfServiceEntryTable         entries;
+    ZConfResolverTable             resolvers;
+    QHash<QString, QList<ZConfResolverKey> > queued;
+    QSet<ZConfResolverKey>         queuedKeys;
+    QHash<QString, int>            domainInFlight;
+    QSet<ZConfResolverKey>         instances;
+    QHash<QString, QSet<ZConfResolverKey> > instancesOf;
+    QHash<QString, QString>        owner;
+    QHash<ZConfResolverKey, ZConfServiceEntry> resolved;
+    QHash<QString, ZConfResolverKey> canonical;
+    QSet<QString>                  localNames;
+    QTimer                         sweeper;
     QString                        type;
     AvahiProtocol                  proto = AVAHI_PROTO_UNSPEC;
+    int                            inFlight = 0;
+    int                            maxConcurrentResolves = 0;
+    int                            resolveTimeout = 10000;
+    bool                           watch = false;
+    bool                           allForNow = false;
+    bool                           localFastPath = true;
+    bool                           enumerateDomains = false;
+    bool                           replaying = false;
+    QVector<ZConfServiceChange>    changeLog = QVector<ZConfServiceChange>(1024);
+    int                            changeHead = 0;
+    int                            changeCount = 0;
+    quint64                        sequence = 0;
 };
 
 /*!
@@ -244,7 +1065,17 @@ public:
 
     ZConfServiceBrowser will emit serviceEntryAdded() when a new service is
     discovered and serviceEntryRemoved() when a service is removed from the
-    network.
+    network. A service that is announced on several interfaces or protocols
+    is removed when the last of these announcements goes away; pending
+    resolves of a removed announcement are cancelled. If a later resolve of a
+    known service yields different data, serviceEntryUpdated() is emitted
+    instead of serviceEntryAdded(). Results that do not change anything are
+    not reported at all.
+
+    By default only the default domain is browsed. Further domains, such as
+    unicast DNS-SD domains of other sites, can be added with addDomain() or
+    discovered automatically with setDomainEnumeration(). All domains share
+    the browser's entry table and resolver pipeline.
  */
 
 /*!
@@ -253,22 +1084,25 @@ public:
  */
 ZConfServiceBrowser::ZConfServiceBrowser(QObject *parent)
     : QObject(parent),
-      d_ptr(new ZConfServiceBrowserPrivate(new ZConfServiceClient(this)))
+      d_ptr(new ZConfServiceBrowserPrivate(this, new ZConfServiceClient(this)))
 {
     connect(d_ptr->client, &ZConfServiceClient::clientRunning, [this]()
     {
-        if(nullptr != this->d_ptr->browser)
-        {
-            return;
-        }
-        this->d_ptr->browser = avahi_service_browser_new(d_ptr->client->client,
-                                                         AVAHI_IF_UNSPEC,
-                                                         d_ptr->proto,
-                                                         d_ptr->type.toLocal8Bit().data(),
-                                                         NULL,
-                                                         (AvahiLookupFlags) 0,
-                                                         ZConfServiceBrowserPrivate::callback,
-                                                         this);
+        this->d_ptr->startBrowsers();
+    });
+
+    ZConfLocalRegistry * const registry = ZConfLocalRegistry::instance();
+    connect(registry, &ZConfLocalRegistry::servicePublished, this, [this](const QString & type, const QString & name)
+    {
+        this->d_ptr->insertLocal(type, name);
+    });
+    connect(registry, &ZConfLocalRegistry::serviceUpdated, this, [this](const QString & type, const QString & name)
+    {
+        this->d_ptr->insertLocal(type, name);
+    });
+    connect(registry, &ZConfLocalRegistry::serviceWithdrawn, this, [this](const QString & type, const QString & name)
+    {
+        this->d_ptr->removeLocal(type, name);
     });
 }
 
@@ -277,10 +1111,8 @@ ZConfServiceBrowser::ZConfServiceBrowser(QObject *parent)
  */
 ZConfServiceBrowser::~ZConfServiceBrowser()
 {
-    if(nullptr != d_ptr->browser)
-    {
-        avahi_service_browser_free(d_ptr->browser);
-    }
+    d_ptr->cancelAll();
+    d_ptr->stopBrowsers();
     delete d_ptr;
 }
 
@@ -309,13 +1141,554 @@ void ZConfServiceBrowser::browse(const QString & serviceType, Protocol proto)
     d_ptr->proto = convertProtocol(proto);
     assert(nullptr != d_ptr->client);
     d_ptr->client->run();
+
+    // Report services published by this process without waiting for the
+    // daemon. This is deferred so that callers can connect to the signals
+    // after calling browse().
+    QTimer::singleShot(0, this, [this]()
+    {
+        for(const ZConfLocalService & service : ZConfLocalRegistry::instance()->services(d_ptr->type))
+        {
+            d_ptr->insertLocal(service.type, service.name);
+        }
+    });
+}
+
+/*!
+    Feeds the browser with the events of \a trace instead of the network.
+    Only the service browser and resolver events recorded for \a serviceType
+    are used; the browser then reports them exactly as it would the live
+    daemon's, once ZConfTraceReplay::start() is called. A browser attached to
+    a trace does not browse the network.
+
+    Client state changes are recorded once per process, not per client, and
+    are passed to the browser's client as they are. Domain enumeration is not
+    recorded, so a replayed browser only sees the domains it was given.
+ */
+void ZConfServiceBrowser::replay(ZConfTraceReplay * trace, const QString & serviceType)
+{
+    d_ptr->cancelAll();
+    d_ptr->stopBrowsers();
+    d_ptr->replaying = true;
+    d_ptr->type      = serviceType;
+    connect(trace, &ZConfTraceReplay::browserEvent, this, [this](const ZConfBrowserEvent & event)
+    {
+        if(d_ptr->type == event.source)
+        {
+            d_ptr->browserEvent(event);
+        }
+    });
+    connect(trace, &ZConfTraceReplay::resolverEvent, this, [this](const ZConfResolverEvent & event)
+    {
+        if(d_ptr->type == event.source)
+        {
+            d_ptr->replayedResolverEvent(event);
+        }
+    });
+    connect(trace, &ZConfTraceReplay::clientStateChanged, this, [this](AvahiClientState state)
+    {
+        d_ptr->client->stateChanged(state);
+    });
+}
+
+/*!
+    Adds \a domain (e.g., a unicast DNS-SD domain such as "site2.example.com")
+    to the domains browsed. Services found in it are added to the same entry
+    table as those of the default domain, which is browsed as the empty
+    string. Since the table is keyed by name, a name found in several domains
+    is reported for the domain it was found in first; it moves to another
+    domain only once the first one no longer has it.
+ */
+void ZConfServiceBrowser::addDomain(const QString & domain)
+{
+    if(!d_ptr->domains.contains(domain))
+    {
+        d_ptr->domains.append(domain);
+    }
+    d_ptr->discovered.remove(domain);
+    d_ptr->startBrowser(domain);
+}
+
+/*!
+    Stops browsing \a domain and removes all services found only in it.
+ */
+void ZConfServiceBrowser::removeDomain(const QString & domain)
+{
+    d_ptr->removeDomain(domain);
+}
+
+/*!
+    Returns the domains browsed, including those found through domain
+    enumeration. The default domain is listed as the empty string.
+ */
+QStringList ZConfServiceBrowser::domains() const
+{
+    return d_ptr->domains;
+}
+
+/*!
+    Enables or disables automatic domain enumeration. When enabled, the
+    browse domains announced on the network are discovered with an Avahi
+    domain browser and browsed as they appear; domainAdded() and
+    domainRemoved() report them. Disabling enumeration stops browsing the
+    domains that were discovered this way.
+ */
+void ZConfServiceBrowser::setDomainEnumeration(bool enabled)
+{
+    d_ptr->enumerateDomains = enabled;
+    if(enabled)
+    {
+        d_ptr->startBrowsers();
+        return;
+    }
+    if(nullptr != d_ptr->domainBrowser)
+    {
+        avahi_domain_browser_free(d_ptr->domainBrowser);
+        d_ptr->domainBrowser = nullptr;
+    }
+    d_ptr->enumerated.clear();
+    for(const QString & domain : d_ptr->discovered.values())
+    {
+        d_ptr->removeDomain(domain);
+    }
+}
+
+/*!
+    Returns true if browse domains are enumerated automatically.
+ */
+bool ZConfServiceBrowser::domainEnumeration() const
+{
+    return d_ptr->enumerateDomains;
+}
+
+/*!
+    Limits the number of resolves running at the same time in each domain to
+    \a perDomain. Further services are queued and resolved as running
+    resolves finish. Zero or a negative value, the default, means no limit.
+ */
+void ZConfServiceBrowser::setMaxConcurrentResolves(int perDomain)
+{
+    d_ptr->maxConcurrentResolves = perDomain;
+    for(const QString & domain : d_ptr->queued.keys())
+    {
+        d_ptr->startQueued(domain);
+    }
+}
+
+/*!
+    Returns the maximum number of concurrent resolves per domain.
+ */
+int ZConfServiceBrowser::maxConcurrentResolves() const
+{
+    return d_ptr->maxConcurrentResolves;
 }
 
+/*!
+    \fn void ZConfServiceBrowser::domainAdded(const QString & domain)
+
+    Emitted when domain enumeration discovers the browse domain \a domain.
+ */
+
+/*!
+    \fn void ZConfServiceBrowser::domainRemoved(const QString & domain)
+
+    Emitted when the browse domain \a domain is no longer announced.
+ */
+
+/*!
+    \fn void ZConfServiceBrowser::serviceEntryUpdated(const QString & name, ZConfServiceEntry::Fields changed)
+
+    Emitted when the service \a name, which was already known, is resolved
+    again with different data. \a changed holds the fields that differ from
+    the previous entry.
+ */
+
+/*!
+    \fn void ZConfServiceBrowser::allForNow()
+
+    Emitted when the daemon has reported all services currently known for the
+    browsed type and every resolve started so far has completed.
+ */
+
+/*!
+    \fn void ZConfServiceBrowser::serviceResolveTimeout(const QString & name)
+
+    Emitted when the service \a name could not be resolved within the resolve
+    timeout, see setResolveTimeout().
+ */
+
+/*!
+    \fn void ZConfServiceBrowser::serviceBrowserFailure()
+
+    Emitted when the underlying Avahi service browser fails.
+ */
+
 /*!
     Returns a ZConfServiceEntry struct with detailed information about the
     Zeroconf service associated with the name.
  */
 const ZConfServiceEntry& ZConfServiceBrowser::serviceEntry(const QString & name) const
 {
-    return d_ptr->entries[name];
+    // Looking up an unknown name must not insert an empty entry, which
+    // would later be mistaken for a known service.
+    static const ZConfServiceEntry empty = ZConfServiceEntry();
+    ZConfServiceEntryTable::const_iterator it = d_ptr->entries.constFind(name);
+    return d_ptr->entries.constEnd() == it ? empty : *it;
+}
+
+/*!
+    Returns all services found so far, keyed by name.
+ */
+ZConfServiceEntryTable ZConfServiceBrowser::serviceEntries() const
+{
+    return d_ptr->entries;
+}
+
+/*!
+    Returns the names of all services found so far.
+ */
+QStringList ZConfServiceBrowser::serviceNames() const
+{
+    return d_ptr->entries.keys();
+}
+
+/*!
+    Returns the service type passed to browse().
+ */
+QString ZConfServiceBrowser::serviceType() const
+{
+    return d_ptr->type;
+}
+
+/*!
+    Enables or disables watching of resolved services. By default the resolver
+    of a service is released as soon as the service has been resolved, so
+    later changes (e.g., a new address after a DHCP renewal or updated TXT
+    records) go unnoticed until the service is removed and announced again.
+
+    With watching enabled, the resolver is kept alive for as long as the
+    service exists and serviceEntryUpdated() is emitted whenever any of the
+    entry's fields change. Services resolved before watching is enabled are
+    resolved again to watch them. Disabling watching releases all watched
+    resolvers.
+ */
+void ZConfServiceBrowser::setWatchChanges(bool enabled)
+{
+    if(enabled == d_ptr->watch)
+    {
+        return;
+    }
+    d_ptr->watch = enabled;
+    if(enabled)
+    {
+        d_ptr->startWatchers();
+    }
+    else
+    {
+        d_ptr->releaseWatchers();
+    }
+}
+
+/*!
+    Returns true if resolved services are watched for changes.
+ */
+bool ZConfServiceBrowser::watchChanges() const
+{
+    return d_ptr->watch;
+}
+
+/*!
+    Sets the time in milliseconds after which an unfinished resolve is
+    cancelled and serviceResolveTimeout() is emitted. The default is 10000
+    milliseconds; zero or a negative value leaves timeouts to the daemon.
+ */
+void ZConfServiceBrowser::setResolveTimeout(int msec)
+{
+    d_ptr->resolveTimeout = msec;
+    if(0 < msec && 0 < d_ptr->inFlight)
+    {
+        d_ptr->sweeper.start(qMin(msec, 1000));
+    }
+}
+
+/*!
+    Returns the resolve timeout in milliseconds.
+ */
+int ZConfServiceBrowser::resolveTimeout() const
+{
+    return d_ptr->resolveTimeout;
+}
+
+/*!
+    Enables or disables the local fast path, which is enabled by default.
+
+    Services that this process publishes with ZConfService are then reported
+    as soon as they are committed, without a round trip through the daemon or
+    a resolve. Such entries are flagged as local and carry the published
+    address, or the loopback address for services on this host. Services
+    published for another host without an address record are left to the
+    daemon. When the daemon reports the service, its result replaces the
+    entry; serviceEntryUpdated() is emitted for differences other than the
+    interface, address, protocol and flags, which the fast path cannot know.
+ */
+void ZConfServiceBrowser::setLocalFastPath(bool enabled)
+{
+    d_ptr->localFastPath = enabled;
+}
+
+/*!
+    Returns true if services published by this process are reported without a
+    round trip through the daemon.
+ */
+bool ZConfServiceBrowser::localFastPath() const
+{
+    return d_ptr->localFastPath;
+}
+
+/*!
+    Browses once for services of type \a serviceType and returns a future that
+    yields all resolved entries. The future finishes as soon as the daemon
+    reports that all services are known and resolved (see allForNow()), when
+    browsing fails, or after \a timeout milliseconds, whichever comes first. A
+    negative timeout waits without limit.
+
+    The lookup is driven by the event loop of the calling thread. Use a
+    QFutureWatcher, or zconfAwait() when no event loop is running.
+ */
+QFuture<ZConfServiceEntryTable> ZConfServiceBrowser::browseOnce(const QString & serviceType, int timeout, Protocol proto)
+{
+    QFutureInterface<ZConfServiceEntryTable> promise;
+    promise.reportStarted();
+
+    ZConfServiceBrowser * const browser = new ZConfServiceBrowser;
+    auto finish = [browser, promise]() mutable
+    {
+        if(!promise.isFinished())
+        {
+            promise.reportResult(browser->d_ptr->entries);
+            promise.reportFinished();
+        }
+        browser->deleteLater();
+    };
+
+    connect(browser, &ZConfServiceBrowser::allForNow,             browser, finish);
+    connect(browser, &ZConfServiceBrowser::serviceBrowserFailure, browser, finish);
+    connect(browser->d_ptr->client, &ZConfServiceClient::clientFailure, browser, finish);
+    if(0 <= timeout)
+    {
+        QTimer::singleShot(timeout, browser, finish);
+    }
+    browser->browse(serviceType, proto);
+    return promise.future();
+}
+
+namespace
+{
+    // A lookup started by ZConfServiceBrowser::resolve(). It is a child of
+    // the shared client, so it never outlives the resolver it owns, and it
+    // finishes its future exactly once.
+    class ZConfResolveOnce : public QObject
+    {
+    public:
+        ZConfResolveOnce(const QString & in_name, const QString & in_type, AvahiProtocol const in_proto, QObject * const parent)
+            : QObject(parent)
+            , name(in_name)
+            , type(in_type)
+            , proto(in_proto)
+        {
+            promise.reportStarted();
+        }
+
+        ~ZConfResolveOnce()
+        {
+            // The client frees its resolvers itself when it goes away.
+            resolver = nullptr;
+            finish(ZConfServiceEntry());
+        }
+
+        void start(AvahiClient * const client)
+        {
+            if(nullptr != resolver || promise.isFinished())
+            {
+                return;
+            }
+            resolver = avahi_service_resolver_new(client,
+                                                  AVAHI_IF_UNSPEC,
+                                                  proto,
+                                                  name.toLocal8Bit().data(),
+                                                  type.toLocal8Bit().data(),
+                                                  nullptr,
+                                                  AVAHI_PROTO_UNSPEC,
+                                                  (AvahiLookupFlags) 0,
+                                                  ZConfResolveOnce::callback,
+                                                  this);
+            if(nullptr == resolver)
+            {
+                qDebug() << (QLatin1String("Failed to resolve service '") % name % QLatin1String("': ") % avahi_strerror(avahi_client_errno(client)));
+                finish(ZConfServiceEntry());
+            }
+        }
+
+        void finish(const ZConfServiceEntry & entry)
+        {
+            if(promise.isFinished())
+            {
+                return;
+            }
+            if(nullptr != resolver)
+            {
+                avahi_service_resolver_free(resolver);
+                resolver = nullptr;
+            }
+            promise.reportResult(entry);
+            promise.reportFinished();
+            deleteLater();
+        }
+
+        static void callback(AvahiServiceResolver   * const resolver,
+                             AvahiIfIndex             const interface,
+                             AvahiProtocol            const protocol,
+                             AvahiResolverEvent       const event,
+                             const char             * const name,
+                             const char             * const type,
+                             const char             * const domain,
+                             const char             * const host_name,
+                             const AvahiAddress     * const address,
+                             uint16_t                 const port,
+                             AvahiStringList        *       txt,
+                             AvahiLookupResultFlags   const flags,
+                             void                   * const userdata)
+        {
+            Q_UNUSED(resolver);
+            Q_UNUSED(name);
+            ZConfResolveOnce * const lookup = static_cast<ZConfResolveOnce *>(userdata);
+            if(AVAHI_RESOLVER_FOUND != event)
+            {
+                lookup->finish(ZConfServiceEntry());
+                return;
+            }
+            char addr[AVAHI_ADDRESS_STR_MAX];
+            avahi_address_snprint(addr, sizeof(addr), address);
+            QList<QByteArray> records;
+            for(; nullptr != txt; txt = txt->next)
+            {
+                records.append(QByteArray::fromRawData(reinterpret_cast<const char *>(txt->text), int(txt->size)));
+            }
+            lookup->finish({interface,
+                            QString::fromLocal8Bit(addr),
+                            QString(domain),
+                            QString(type),
+                            QString(host_name),
+                            port,
+                            protocol,
+                            flags,
+                            parseTXTRecords(records)});
+        }
+
+        QFutureInterface<ZConfServiceEntry> promise;
+        AvahiServiceResolver * resolver = nullptr;
+        QString                name;
+        QString                type;
+        AvahiProtocol          proto;
+    };
+}
+
+/*!
+    Looks up the service \a name of type \a serviceType in the default domain
+    and returns a future that yields its entry. The service is resolved
+    directly on the calling thread's shared client, without browsing for the
+    type. If the service cannot be resolved within \a timeout milliseconds,
+    or the lookup fails, the future yields an invalid entry.
+
+    The lookup is driven by the event loop of the calling thread. Use a
+    QFutureWatcher, or zconfAwait() when no event loop is running.
+ */
+QFuture<ZConfServiceEntry> ZConfServiceBrowser::resolve(const QString & name, const QString & serviceType, int timeout, Protocol proto)
+{
+    ZConfServiceClient * const client = ZConfServiceClient::shared();
+    ZConfResolveOnce   * const lookup = new ZConfResolveOnce(name, serviceType, convertProtocol(proto), client);
+    const QFuture<ZConfServiceEntry> future = lookup->promise.future();
+
+    connect(client, &ZConfServiceClient::clientFailure, lookup, [lookup]() { lookup->finish(ZConfServiceEntry()); });
+    if(0 <= timeout)
+    {
+        QTimer::singleShot(timeout, lookup, [lookup]() { lookup->finish(ZConfServiceEntry()); });
+    }
+    if(   (nullptr != client->client)
+       && (AVAHI_CLIENT_S_RUNNING == avahi_client_get_state(client->client)))
+    {
+        lookup->start(client->client);
+    }
+    else
+    {
+        connect(client, &ZConfServiceClient::clientRunning, lookup, [lookup, client]() { lookup->start(client->client); });
+    }
+    return future;
+}
+
+/*!
+    Returns the sequence number of the last change of the entry table, or 0
+    if nothing has changed yet. Every added, removed or updated service
+    increments the sequence number by one.
+ */
+quint64 ZConfServiceBrowser::currentSequence() const
+{
+    return d_ptr->sequence;
+}
+
+/*!
+    Returns the changes of the entry table made after \a sequence, in the
+    order they were made, along with the current sequence number to pass to
+    the next call.
+
+    Only the last changeLogCapacity() changes are kept. If changes after \a
+    sequence have been dropped already, or \a sequence is not a sequence
+    number of this browser, the change set is marked as a snapshot and
+    contains no changes; the caller must then resynchronize from
+    serviceEntries() or serviceNames().
+ */
+ZConfServiceChangeSet ZConfServiceBrowser::changesSince(quint64 sequence) const
+{
+    const ZConfServiceBrowserPrivate * const d = d_ptr;
+    ZConfServiceChangeSet changeSet{d->sequence, false, QList<ZConfServiceChange>()};
+    if(sequence == d->sequence)
+    {
+        return changeSet;
+    }
+
+    const int     capacity = d->changeLog.size();
+    const quint64 oldest   = 0 < d->changeCount ? d->changeLog.at(d->changeHead).sequence : d->sequence + 1;
+    if(sequence > d->sequence || sequence + 1 < oldest)
+    {
+        changeSet.snapshot = true;
+        return changeSet;
+    }
+
+    const int first = int(sequence + 1 - oldest);
+    changeSet.changes.reserve(d->changeCount - first);
+    for(int i = first; i < d->changeCount; ++i)
+    {
+        changeSet.changes.append(d->changeLog.at((d->changeHead + i) % capacity));
+    }
+    return changeSet;
+}
+
+/*!
+    Keeps the last \a capacity changes for changesSince(); the default is
+    1024. Changing the capacity drops the changes kept so far, and zero
+    disables the change log. Sequence numbers continue to be counted.
+ */
+void ZConfServiceBrowser::setChangeLogCapacity(int capacity)
+{
+    d_ptr->changeLog   = QVector<ZConfServiceChange>(qMax(0, capacity));
+    d_ptr->changeHead  = 0;
+    d_ptr->changeCount = 0;
+}
+
+/*!
+    Returns the number of changes kept for changesSince().
+ */
+int ZConfServiceBrowser::changeLogCapacity() const
+{
+    return d_ptr->changeLog.size();
 }
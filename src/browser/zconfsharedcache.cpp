@@ -0,0 +1,713 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <QDebug>
+
+#include <QAtomicInt>
+#include <QDataStream>
+#include <QSocketNotifier>
+#include <QStringBuilder>
+#include <QThread>
+#include <QTimer>
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qtzeroconf/zconfsharedcache.h"
+
+namespace
+{
+    static const quint32 segmentMagic   = 0x5a435348; // "ZCSH"
+    static const quint32 segmentVersion = 1;
+
+    // Layout of the start of a segment. The entry table follows at
+    // dataOffset, serialized with QDataStream.
+    //
+    // The table is guarded by a sequence lock: the publisher makes the
+    // sequence odd while it writes and even again when it is done, then
+    // wakes the readers waiting on the sequence with a futex. Readers copy
+    // the table and retry if the sequence changed meanwhile, so neither side
+    // ever blocks the other.
+    struct ZConfSharedHeader
+    {
+        quint32              magic;
+        quint32              version;
+        std::atomic<quint32> sequence;
+        std::atomic<quint32> length;
+        std::atomic<quint32> closed;
+        quint32              capacity;
+        qint64               pid;
+    };
+
+    static const int dataOffset = 64;
+    static_assert(sizeof(ZConfSharedHeader) <= dataOffset, "segment header too large");
+
+    static inline char * segmentData(ZConfSharedHeader * const header)
+    {
+        return reinterpret_cast<char *>(header) + dataOffset;
+    }
+
+    static inline int futex(std::atomic<quint32> * const word, int const op, quint32 const value, const timespec * const timeout)
+    {
+        return int(syscall(SYS_futex, reinterpret_cast<quint32 *>(word), op, value, timeout, nullptr, 0));
+    }
+
+    static inline bool isAlive(qint64 const pid)
+    {
+        return 0 == kill(pid_t(pid), 0) || ESRCH != errno;
+    }
+
+    static void writeTable(QDataStream & stream, const ZConfServiceEntryTable & entries)
+    {
+        stream << quint32(entries.size());
+        for(ZConfServiceEntryTable::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it)
+        {
+            const ZConfServiceEntry & entry = it.value();
+            stream << it.key()
+                   << qint32(entry.interface)
+                   << entry.ip
+                   << entry.domain
+                   << entry.type
+                   << entry.host
+                   << quint16(entry.port)
+                   << qint32(entry.protocol)
+                   << quint32(entry.flags)
+                   << entry.TXTRecords;
+        }
+    }
+
+    static bool readTable(QDataStream & stream, ZConfServiceEntryTable * const entries)
+    {
+        quint32 count = 0;
+        stream >> count;
+        entries->reserve(int(count));
+        for(quint32 i = 0; i < count && QDataStream::Ok == stream.status(); ++i)
+        {
+            QString           name;
+            ZConfServiceEntry entry = ZConfServiceEntry();
+            qint32            interface = 0, protocol = 0;
+            quint32           flags = 0;
+            quint16           port  = 0;
+            stream >> name
+                   >> interface
+                   >> entry.ip
+                   >> entry.domain
+                   >> entry.type
+                   >> entry.host
+                   >> port
+                   >> protocol
+                   >> flags
+                   >> entry.TXTRecords;
+            entry.interface = (AvahiIfIndex) interface;
+            entry.port      = port;
+            entry.protocol  = (AvahiProtocol) protocol;
+            entry.flags     = (AvahiLookupResultFlags) flags;
+            entries->insert(name, entry);
+        }
+        return QDataStream::Ok == stream.status();
+    }
+}
+
+class ZConfSharedCachePublisherPrivate
+{
+public:
+    ZConfSharedCachePublisherPrivate(ZConfServiceBrowser * const in_browser, int const in_capacity)
+        : browser(in_browser)
+        , capacity(in_capacity)
+    {
+        timer.setSingleShot(true);
+        timer.setInterval(0);
+        QObject::connect(&timer, &QTimer::timeout, [this]()
+        {
+            publish();
+        });
+    }
+
+    // Creates the segment. A segment left behind by a publisher that no
+    // longer runs is taken over; one of a running publisher is not.
+    bool open(const QString & serviceType)
+    {
+        name = ZConfSharedCachePublisher::segmentName(serviceType);
+        const QByteArray path = name.toLocal8Bit();
+        const size_t size = size_t(dataOffset) + size_t(capacity);
+
+        fd = shm_open(path.constData(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if(0 > fd && EEXIST == errno)
+        {
+            const int existing = shm_open(path.constData(), O_RDONLY, 0);
+            struct stat info;
+            bool stale = true;
+            if(0 <= existing && 0 == fstat(existing, &info) && size_t(info.st_size) >= sizeof(ZConfSharedHeader))
+            {
+                void * const mapped = mmap(nullptr, sizeof(ZConfSharedHeader), PROT_READ, MAP_SHARED, existing, 0);
+                if(MAP_FAILED != mapped)
+                {
+                    const ZConfSharedHeader * const old = static_cast<const ZConfSharedHeader *>(mapped);
+                    stale = 0 != old->closed.load() || !isAlive(old->pid);
+                    munmap(mapped, sizeof(ZConfSharedHeader));
+                }
+            }
+            if(0 <= existing)
+            {
+                ::close(existing);
+            }
+            if(!stale)
+            {
+                qDebug() << (QLatin1String("Shared cache '") % name % QLatin1String("' is published by another process."));
+                return false;
+            }
+            // Readers of the old segment keep their mapping and notice
+            // that it was closed; new readers get the new segment.
+            shm_unlink(path.constData());
+            fd = shm_open(path.constData(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        }
+        if(0 > fd)
+        {
+            qDebug() << (QLatin1String("Cannot create shared cache '") % name % QLatin1String("': ") % QString::fromLocal8Bit(strerror(errno)));
+            return false;
+        }
+        void * mapped = MAP_FAILED;
+        if(0 == ftruncate(fd, off_t(size)))
+        {
+            mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if(MAP_FAILED == mapped)
+        {
+            qDebug() << (QLatin1String("Cannot map shared cache '") % name % QLatin1String("': ") % QString::fromLocal8Bit(strerror(errno)));
+            close();
+            return false;
+        }
+
+        header = new (mapped) ZConfSharedHeader;
+        header->sequence.store(0);
+        header->length.store(0);
+        header->closed.store(0);
+        header->capacity = quint32(capacity);
+        header->pid      = qint64(getpid());
+        header->version  = segmentVersion;
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic    = segmentMagic;
+        return true;
+    }
+
+    void close()
+    {
+        if(nullptr != header)
+        {
+            header->closed.store(1);
+            header->sequence.fetch_add(2);
+            futex(&header->sequence, FUTEX_WAKE, INT_MAX, nullptr);
+            munmap(header, size_t(dataOffset) + size_t(capacity));
+            header = nullptr;
+        }
+        if(0 <= fd)
+        {
+            ::close(fd);
+            shm_unlink(name.toLocal8Bit().constData());
+            fd = -1;
+        }
+    }
+
+    void schedule()
+    {
+        if(!timer.isActive())
+        {
+            timer.start();
+        }
+    }
+
+    // Writes the browser's whole entry table. Changes are coalesced, so a
+    // burst of announcements results in a single write.
+    void publish()
+    {
+        if(nullptr == header && (browser->serviceType().isEmpty() || !open(browser->serviceType())))
+        {
+            return;
+        }
+
+        buffer.clear();
+        QDataStream stream(&buffer, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+        writeTable(stream, browser->serviceEntries());
+        if(capacity < buffer.size())
+        {
+            qDebug() << (QLatin1String("Shared cache '") % name % QLatin1String("' is too small for ") % QString::number(buffer.size()) % QLatin1String(" bytes."));
+            return;
+        }
+
+        const quint32 sequence = header->sequence.load(std::memory_order_relaxed);
+        header->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(segmentData(header), buffer.constData(), size_t(buffer.size()));
+        header->length.store(quint32(buffer.size()), std::memory_order_relaxed);
+        header->sequence.store(sequence + 2, std::memory_order_release);
+        futex(&header->sequence, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+
+    ZConfServiceBrowser * const browser;
+    int                   const capacity;
+    ZConfSharedHeader   *       header = nullptr;
+    int                         fd     = -1;
+    QString                     name;
+    QByteArray                  buffer;
+    QTimer                      timer;
+};
+
+/*!
+    \class ZConfSharedCachePublisher
+
+    \brief Publishes the entry table of a ZConfServiceBrowser into a shared
+    memory segment, for ZConfSharedBrowser objects in other processes.
+
+    When several processes on a host browse for the same service type, one
+    of them (or a small helper process) can own the browser and publish its
+    results with this class. The others use ZConfSharedBrowser instead of a
+    browser of their own, so the daemon sees one subscription and resolves
+    each service once, however many processes consume the results.
+
+    The segment is named after the service type (see segmentName()) and
+    holds at most \a capacity bytes of serialized entries. Only one process
+    can publish a service type at a time. The segment is removed when the
+    publisher is destroyed.
+ */
+
+/*!
+    Creates a publisher for \a browser. The publisher is a child of the
+    browser and starts publishing once the browser browses for a type.
+ */
+ZConfSharedCachePublisher::ZConfSharedCachePublisher(ZConfServiceBrowser * const browser, int const capacity)
+    : QObject(browser),
+      d_ptr(new ZConfSharedCachePublisherPrivate(browser, capacity))
+{
+    connect(browser, &ZConfServiceBrowser::serviceEntryAdded, this, [this]()
+    {
+        d_ptr->schedule();
+    });
+    connect(browser, &ZConfServiceBrowser::serviceEntryRemoved, this, [this]()
+    {
+        // The entry is still in the table while the signal is emitted; the
+        // write is deferred until it is gone.
+        d_ptr->schedule();
+    });
+    connect(browser, &ZConfServiceBrowser::serviceEntryUpdated, this, [this]()
+    {
+        d_ptr->schedule();
+    });
+    connect(browser, &ZConfServiceBrowser::allForNow, this, [this]()
+    {
+        d_ptr->schedule();
+    });
+    d_ptr->schedule();
+}
+
+/*!
+    Removes the shared memory segment and destroys the publisher.
+ */
+ZConfSharedCachePublisher::~ZConfSharedCachePublisher()
+{
+    d_ptr->close();
+    delete d_ptr;
+}
+
+/*!
+    Returns true if the segment has been created.
+ */
+bool ZConfSharedCachePublisher::isValid() const
+{
+    return nullptr != d_ptr->header;
+}
+
+/*!
+    Returns the name of the segment, or an empty string if it has not been
+    created yet.
+ */
+QString ZConfSharedCachePublisher::segmentName() const
+{
+    return d_ptr->name;
+}
+
+/*!
+    Returns the name of the shared memory segment used for \a serviceType.
+ */
+QString ZConfSharedCachePublisher::segmentName(const QString & serviceType)
+{
+    QString name = serviceType;
+    name.replace(QLatin1Char('/'), QLatin1Char('_'));
+    return QLatin1String("/qtzeroconf-") % name;
+}
+
+namespace
+{
+    // Waits on the segment's sequence and signals the reader's eventfd
+    // whenever the publisher has finished a write or gone away.
+    class ZConfSharedWatcher : public QThread
+    {
+    public:
+        ZConfSharedWatcher(ZConfSharedHeader * const in_header, int const in_notify)
+            : header(in_header)
+            , notify(in_notify)
+        { }
+
+        void stop()
+        {
+            stopping.store(1);
+            wait();
+        }
+
+    protected:
+        void run()
+        {
+            static const timespec timeout = {0, 500 * 1000 * 1000};
+            static const quint64  one     = 1;
+            quint32 waitOn   = header->sequence.load();
+            quint32 reported = waitOn;
+            while(0 == stopping.load())
+            {
+                futex(&header->sequence, FUTEX_WAIT, waitOn, &timeout);
+                const quint32 sequence = header->sequence.load();
+                bool changed = false;
+                if(0 == (sequence & 1))
+                {
+                    changed  = (sequence != reported);
+                    reported = sequence;
+                }
+                // While a write is in progress, wait for it to end instead
+                // of spinning on the odd value.
+                waitOn = sequence;
+                if(changed || !isAlive(header->pid))
+                {
+                    if(sizeof(one) != write(notify, &one, sizeof(one)))
+                    {
+                        qDebug() << QLatin1String("Cannot notify shared browser.");
+                    }
+                    if(0 != header->closed.load() || !isAlive(header->pid))
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+
+    private:
+        ZConfSharedHeader * const header;
+        int                 const notify;
+        QAtomicInt                stopping;
+    };
+}
+
+class ZConfSharedBrowserPrivate
+{
+public:
+    ZConfSharedBrowserPrivate(ZConfSharedBrowser * const in_q)
+        : q(in_q)
+    {
+        retry.setInterval(1000);
+        QObject::connect(&retry, &QTimer::timeout, [this]()
+        {
+            attach();
+        });
+    }
+
+    bool attach()
+    {
+        const QByteArray path = ZConfSharedCachePublisher::segmentName(type).toLocal8Bit();
+        const int fd = shm_open(path.constData(), O_RDONLY, 0);
+        if(0 > fd)
+        {
+            return false;
+        }
+        struct stat info;
+        void * mapped = MAP_FAILED;
+        if(0 == fstat(fd, &info) && dataOffset <= info.st_size)
+        {
+            mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if(MAP_FAILED == mapped)
+        {
+            return false;
+        }
+
+        ZConfSharedHeader * const segment = static_cast<ZConfSharedHeader *>(mapped);
+        if(   segmentMagic != segment->magic
+           || segmentVersion != segment->version
+           || size_t(info.st_size) < size_t(dataOffset) + segment->capacity
+           || 0 != segment->closed.load()
+           || !isAlive(segment->pid))
+        {
+            munmap(mapped, size_t(info.st_size));
+            return false;
+        }
+
+        header  = segment;
+        size    = size_t(info.st_size);
+        eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(0 > eventFd)
+        {
+            detach();
+            return false;
+        }
+        notifier = new QSocketNotifier(eventFd, QSocketNotifier::Read);
+        QObject::connect(notifier, &QSocketNotifier::activated, [this]()
+        {
+            quint64 count;
+            if(sizeof(count) == read(eventFd, &count, sizeof(count)))
+            {
+                refresh();
+            }
+        });
+        watcher = new ZConfSharedWatcher(header, eventFd);
+        watcher->start();
+        retry.stop();
+
+        refresh();
+        if(nullptr != header)
+        {
+            emit q->allForNow();
+        }
+        return true;
+    }
+
+    void detach()
+    {
+        if(nullptr != watcher)
+        {
+            watcher->stop();
+            delete watcher;
+            watcher = nullptr;
+        }
+        if(nullptr != notifier)
+        {
+            // This may run from the notifier's own signal.
+            notifier->setEnabled(false);
+            notifier->deleteLater();
+            notifier = nullptr;
+        }
+        if(0 <= eventFd)
+        {
+            ::close(eventFd);
+            eventFd = -1;
+        }
+        if(nullptr != header)
+        {
+            munmap(header, size);
+            header = nullptr;
+        }
+    }
+
+    // Copies the table out of the segment under the sequence lock and
+    // reports the differences to the previous copy.
+    void refresh()
+    {
+        if(0 != header->closed.load() || !isAlive(header->pid))
+        {
+            lost();
+            return;
+        }
+
+        QByteArray data;
+        for(;;)
+        {
+            const quint32 before = header->sequence.load(std::memory_order_acquire);
+            if(0 != (before & 1))
+            {
+                if(!isAlive(header->pid))
+                {
+                    lost();
+                    return;
+                }
+                QThread::yieldCurrentThread();
+                continue;
+            }
+            const quint32 length = header->length.load(std::memory_order_relaxed);
+            if(length > header->capacity)
+            {
+                continue;
+            }
+            data = QByteArray(segmentData(header), int(length));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(before == header->sequence.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+
+        ZConfServiceEntryTable table;
+        QDataStream stream(data);
+        stream.setVersion(QDataStream::Qt_5_0);
+        if(!data.isEmpty() && !readTable(stream, &table))
+        {
+            qDebug() << QLatin1String("Invalid shared cache contents.");
+            return;
+        }
+        apply(table);
+    }
+
+    void apply(const ZConfServiceEntryTable & table)
+    {
+        QStringList                      added;
+        QStringList                      updated;
+        QList<ZConfServiceEntry::Fields> changes;
+        for(ZConfServiceEntryTable::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it)
+        {
+            if(!table.contains(it.key()))
+            {
+                emit q->serviceEntryRemoved(it.key());
+            }
+        }
+        for(ZConfServiceEntryTable::const_iterator it = table.constBegin(); it != table.constEnd(); ++it)
+        {
+            ZConfServiceEntryTable::const_iterator old = entries.constFind(it.key());
+            if(entries.constEnd() == old)
+            {
+                added.append(it.key());
+                continue;
+            }
+            const ZConfServiceEntry::Fields changed = old->changedFields(it.value());
+            if(changed)
+            {
+                updated.append(it.key());
+                changes.append(changed);
+            }
+        }
+        entries = table;
+        for(const QString & name : added)
+        {
+            emit q->serviceEntryAdded(name);
+        }
+        for(int i = 0; i < updated.size(); ++i)
+        {
+            emit q->serviceEntryUpdated(updated.at(i), changes.at(i));
+        }
+    }
+
+    // The publisher went away. Its services are dropped and the browser
+    // waits for a new publisher.
+    void lost()
+    {
+        detach();
+        apply(ZConfServiceEntryTable());
+        emit q->serviceBrowserFailure();
+        retry.start();
+    }
+
+    ZConfSharedBrowser     * const q;
+    ZConfSharedHeader      *       header   = nullptr;
+    size_t                         size     = 0;
+    int                            eventFd  = -1;
+    QSocketNotifier        *       notifier = nullptr;
+    ZConfSharedWatcher     *       watcher  = nullptr;
+    ZConfServiceEntryTable         entries;
+    QTimer                         retry;
+    QString                        type;
+};
+
+/*!
+    \class ZConfSharedBrowser
+
+    \brief Read-only view of the entries published by a
+    ZConfSharedCachePublisher in another process.
+
+    ZConfSharedBrowser offers the entry lookup and the signals of
+    ZConfServiceBrowser without talking to avahi-daemon. Changes are picked
+    up as soon as the publisher writes them, through a futex on the shared
+    segment. If no publisher exists yet, or the publisher goes away, the
+    browser attaches to the next one automatically; serviceBrowserFailure()
+    is emitted when a publisher is lost.
+ */
+
+/*!
+    Creates a shared browser. Call browse() to attach to a publisher.
+ */
+ZConfSharedBrowser::ZConfSharedBrowser(QObject * const parent)
+    : QObject(parent),
+      d_ptr(new ZConfSharedBrowserPrivate(this))
+{ }
+
+/*!
+    Detaches from the publisher and destroys the browser.
+ */
+ZConfSharedBrowser::~ZConfSharedBrowser()
+{
+    d_ptr->detach();
+    delete d_ptr;
+}
+
+/*!
+    Attaches to the publisher of \a serviceType. allForNow() is emitted
+    once the published entries have been read.
+ */
+void ZConfSharedBrowser::browse(const QString & serviceType)
+{
+    d_ptr->detach();
+    d_ptr->apply(ZConfServiceEntryTable());
+    d_ptr->type = serviceType;
+    if(!d_ptr->attach())
+    {
+        d_ptr->retry.start();
+    }
+}
+
+/*!
+    Returns true while the browser is attached to a publisher.
+ */
+bool ZConfSharedBrowser::isAttached() const
+{
+    return nullptr != d_ptr->header;
+}
+
+/*!
+    Returns the entry of the service \a name, or an invalid entry if there is
+    no such service.
+ */
+const ZConfServiceEntry & ZConfSharedBrowser::serviceEntry(const QString & name) const
+{
+    static const ZConfServiceEntry empty = ZConfServiceEntry();
+    ZConfServiceEntryTable::const_iterator it = d_ptr->entries.constFind(name);
+    return d_ptr->entries.constEnd() == it ? empty : *it;
+}
+
+/*!
+    Returns all published services, keyed by name.
+ */
+ZConfServiceEntryTable ZConfSharedBrowser::serviceEntries() const
+{
+    return d_ptr->entries;
+}
+
+/*!
+    Returns the names of all published services.
+ */
+QStringList ZConfSharedBrowser::serviceNames() const
+{
+    return d_ptr->entries.keys();
+}
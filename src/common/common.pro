@@ -5,5 +5,11 @@ CONFIG    += link_pkgconfig
 PKGCONFIG += avahi-qt5 avahi-client
 
 INCLUDEPATH += $$PROJ_DIR/include/
-SOURCES     += zconfserviceclient.cpp
-HEADERS     += $$PROJ_DIR/include/qtzeroconf/zconfserviceclient.h
+SOURCES     += zconfserviceclient.cpp \
+               zconflocalregistry.cpp \
+               zconftrace.cpp
+HEADERS     += $$PROJ_DIR/include/qtzeroconf/zconfglobal.h \
+               $$PROJ_DIR/include/qtzeroconf/zconfserviceclient.h \
+               $$PROJ_DIR/include/qtzeroconf/zconflocalregistry.h \
+               $$PROJ_DIR/include/qtzeroconf/zconftrace.h \
+               $$PROJ_DIR/include/qtzeroconf/zconffuture.h
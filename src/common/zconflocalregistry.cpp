@@ -0,0 +1,123 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <QMutexLocker>
+
+#include "qtzeroconf/zconflocalregistry.h"
+
+/*!
+    \class ZConfLocalRegistry
+
+    \brief Process wide table of the services published through ZConfService.
+
+    Browsers of the same process look services up here, so they see their own
+    process' services as soon as they are committed instead of after a round
+    trip through avahi-daemon and a resolve. The daemon's results still
+    arrive later and are reconciled with the entries created from this table.
+ */
+
+ZConfLocalRegistry::ZConfLocalRegistry()
+    : QObject(nullptr)
+{ }
+
+ZConfLocalRegistry::~ZConfLocalRegistry()
+{ }
+
+/*!
+    Returns the registry of this process.
+ */
+ZConfLocalRegistry * ZConfLocalRegistry::instance()
+{
+    static ZConfLocalRegistry registry;
+    return &registry;
+}
+
+/*!
+    Adds or replaces a service and emits servicePublished().
+ */
+void ZConfLocalRegistry::publish(const ZConfLocalService & service)
+{
+    {
+        QMutexLocker lock(&mutex);
+        table[service.type].insert(service.name, service);
+    }
+    emit servicePublished(service.type, service.name);
+}
+
+/*!
+    Replaces the TXT records of a registered service and emits
+    serviceUpdated(). Does nothing if the service is not registered.
+ */
+void ZConfLocalRegistry::update(const QString & type, const QString & name, const QMap<QString, QString> & TXTRecords)
+{
+    {
+        QMutexLocker lock(&mutex);
+        QHash<QString, ZConfLocalServiceTable>::iterator it = table.find(type);
+        if(table.end() == it || !it->contains(name))
+        {
+            return;
+        }
+        (*it)[name].TXTRecords = TXTRecords;
+    }
+    emit serviceUpdated(type, name);
+}
+
+/*!
+    Removes a service and emits serviceWithdrawn() if it was registered.
+ */
+void ZConfLocalRegistry::withdraw(const QString & type, const QString & name)
+{
+    {
+        QMutexLocker lock(&mutex);
+        QHash<QString, ZConfLocalServiceTable>::iterator it = table.find(type);
+        if(table.end() == it || 0 == it->remove(name))
+        {
+            return;
+        }
+        if(it->isEmpty())
+        {
+            table.erase(it);
+        }
+    }
+    emit serviceWithdrawn(type, name);
+}
+
+/*!
+    Returns all services of the given type.
+ */
+QList<ZConfLocalService> ZConfLocalRegistry::services(const QString & type) const
+{
+    QMutexLocker lock(&mutex);
+    return table.value(type).values();
+}
+
+/*!
+    Looks up a single service. Returns false if no such service is registered.
+ */
+bool ZConfLocalRegistry::service(const QString & type, const QString & name, ZConfLocalService * const out) const
+{
+    QMutexLocker lock(&mutex);
+    const QHash<QString, ZConfLocalServiceTable>::const_iterator it = table.constFind(type);
+    if(table.constEnd() == it || !it->contains(name))
+    {
+        return false;
+    }
+    *out = it->value(name);
+    return true;
+}
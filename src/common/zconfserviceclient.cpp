@@ -18,11 +18,14 @@
  */
 
 #include <QDebug>
+#include <QSharedPointer>
+#include <QThreadStorage>
 
 #include <avahi-qt5/qt-watch.h>
 #include <avahi-common/error.h>
 
 #include "qtzeroconf/zconfserviceclient.h"
+#include "qtzeroconf/zconftrace.h"
 
 void ZConfServiceClient::run()
 {
@@ -30,7 +33,27 @@ void ZConfServiceClient::run()
     {
         return;
     }
-    avahi_client_new(poll, (AvahiClientFlags) 0, ZConfServiceClient::callback, this, &error);
+    // The callback may have stored a client that avahi_client_new() then
+    // freed again because it could not connect.
+    if(nullptr == avahi_client_new(poll, (AvahiClientFlags) 0, ZConfServiceClient::callback, this, &error))
+    {
+        client = nullptr;
+    }
+}
+
+// Returns a client shared by all users on the calling thread. The Avahi
+// poll adapter is bound to the thread's event loop, so each thread gets its
+// own client. It is destroyed when the thread exits.
+ZConfServiceClient * ZConfServiceClient::shared()
+{
+    static QThreadStorage<QSharedPointer<ZConfServiceClient> > clients;
+    if(!clients.hasLocalData())
+    {
+        clients.setLocalData(QSharedPointer<ZConfServiceClient>(new ZConfServiceClient,
+                                                                [](ZConfServiceClient * const client) { delete client; }));
+        clients.localData()->run();
+    }
+    return clients.localData().data();
 }
 
 QString ZConfServiceClient::errorString() const
@@ -57,32 +80,43 @@ void ZConfServiceClient::callback(AvahiClient      * const client,
                                   AvahiClientState   const state,
                                   void             * const userdata)
 {
+    if(ZConfTrace::isRecording())
+    {
+        ZConfTrace::recordClientState(state);
+    }
     if(nullptr != userdata)
     {
-        const ZConfServiceClient * const service = static_cast<ZConfServiceClient *>(userdata);
-        const_cast<ZConfServiceClient * const>(service)->client = client;
-        switch(state)
-        {
-        case AVAHI_CLIENT_S_RUNNING:
-            qDebug() << QLatin1String("AVAHI_CLIENT_S_RUNNING");
-            // The server has started up successfully and registered its host
-            // name on the network.
-            emit service->clientRunning();
-            break;
-        case AVAHI_CLIENT_FAILURE:
-            qDebug() << QLatin1String("AVAHI_CLIENT_FAILURE");
-            emit service->clientFailure();
-            break;
-        case AVAHI_CLIENT_S_COLLISION:
-        case AVAHI_CLIENT_S_REGISTERING:
-            qDebug() << (AVAHI_CLIENT_S_COLLISION == state
-                        ? QLatin1String("AVAHI_CLIENT_S_COLLISION")
-                        : QLatin1String("AVAHI_CLIENT_S_REGISTERING"));
-            emit service->clientReset();
-            break;
-        case AVAHI_CLIENT_CONNECTING:
-            qDebug() << QLatin1String("AVAHI_CLIENT_CONNECTING");
-            emit service->clientConnecting();
-        } // end switch
+        ZConfServiceClient * const service = static_cast<ZConfServiceClient *>(userdata);
+        service->client = client;
+        service->stateChanged(state);
     }
 }
+
+// Emits the signal for a state change of the live client, or of a client
+// recorded in a trace that is being replayed.
+void ZConfServiceClient::stateChanged(AvahiClientState const state) const
+{
+    switch(state)
+    {
+    case AVAHI_CLIENT_S_RUNNING:
+        qDebug() << QLatin1String("AVAHI_CLIENT_S_RUNNING");
+        // The server has started up successfully and registered its host
+        // name on the network.
+        emit clientRunning();
+        break;
+    case AVAHI_CLIENT_FAILURE:
+        qDebug() << QLatin1String("AVAHI_CLIENT_FAILURE");
+        emit clientFailure();
+        break;
+    case AVAHI_CLIENT_S_COLLISION:
+    case AVAHI_CLIENT_S_REGISTERING:
+        qDebug() << (AVAHI_CLIENT_S_COLLISION == state
+                    ? QLatin1String("AVAHI_CLIENT_S_COLLISION")
+                    : QLatin1String("AVAHI_CLIENT_S_REGISTERING"));
+        emit clientReset();
+        break;
+    case AVAHI_CLIENT_CONNECTING:
+        qDebug() << QLatin1String("AVAHI_CLIENT_CONNECTING");
+        emit clientConnecting();
+    } // end switch
+}
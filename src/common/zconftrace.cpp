@@ -0,0 +1,463 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <QDebug>
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringBuilder>
+#include <QTimer>
+
+#include "qtzeroconf/zconftrace.h"
+
+namespace
+{
+    // File layout: a header of magic number and format version, followed by
+    // one record per event. Each record starts with its kind and the time in
+    // nanoseconds since recording started. Strings are stored as UTF-8.
+    static const quint32 traceMagic   = 0x5a435452; // "ZCTR"
+    static const quint16 traceVersion = 1;
+
+    enum ZConfTraceKind
+    {
+        ZCONF_TRACE_CLIENT      = 1,
+        ZCONF_TRACE_BROWSER     = 2,
+        ZCONF_TRACE_RESOLVER    = 3,
+        ZCONF_TRACE_ENTRY_GROUP = 4
+    };
+
+    struct ZConfTraceRecord
+    {
+        qint64               time;
+        quint8               kind;
+        AvahiClientState     clientState;
+        ZConfBrowserEvent    browser;
+        ZConfResolverEvent   resolver;
+        ZConfEntryGroupEvent group;
+    };
+
+    static QMutex        recorderMutex;
+    static QFile         recorderFile;
+    static QDataStream   recorderStream;
+    static QElapsedTimer recorderClock;
+
+    static inline void writeString(QDataStream & stream, const QString & string)
+    {
+        stream << string.toUtf8();
+    }
+
+    static inline QString readString(QDataStream & stream)
+    {
+        QByteArray utf8;
+        stream >> utf8;
+        return QString::fromUtf8(utf8);
+    }
+
+    // Must be called with recorderMutex held.
+    static inline void writeRecordHeader(quint8 const kind)
+    {
+        recorderStream << kind << qint64(recorderClock.nsecsElapsed());
+    }
+}
+
+QAtomicInt ZConfTrace::recording(0);
+
+/*!
+    \class ZConfTrace
+
+    \brief Records the Avahi events seen by this process into a binary trace
+    file, for later replay with ZConfTraceReplay.
+
+    While recording, every client state change, the service browser and
+    resolver events of ZConfServiceBrowser, and every entry group state
+    change of ZConfService are written with a timestamp. Client state changes
+    are not attributed to a client; all clients of a process talk to the same
+    daemon. Domain enumeration, lookups made with
+    ZConfServiceBrowser::resolve(), ZConfRecordBrowser and ZConfHostResolver
+    are not recorded. The recording hooks cost a single atomic load when
+    recording is off.
+ */
+
+/*!
+    Starts recording into \a fileName, replacing any existing file. Returns
+    false if the file cannot be opened.
+ */
+bool ZConfTrace::startRecording(const QString & fileName)
+{
+    QMutexLocker lock(&recorderMutex);
+    if(recorderFile.isOpen())
+    {
+        recorderFile.close();
+    }
+    recorderFile.setFileName(fileName);
+    if(!recorderFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << (QLatin1String("Cannot open trace file '") % fileName % QLatin1String("': ") % recorderFile.errorString());
+        recording.store(0);
+        return false;
+    }
+    recorderStream.setDevice(&recorderFile);
+    recorderStream.setVersion(QDataStream::Qt_5_0);
+    recorderStream << traceMagic << traceVersion;
+    recorderClock.start();
+    recording.store(1);
+    return true;
+}
+
+/*!
+    Stops recording and closes the trace file.
+ */
+void ZConfTrace::stopRecording()
+{
+    QMutexLocker lock(&recorderMutex);
+    recording.store(0);
+    recorderStream.setDevice(nullptr);
+    recorderFile.close();
+}
+
+/*!
+    \fn bool ZConfTrace::isRecording()
+
+    Returns true while events are being recorded.
+ */
+
+/*!
+    Records a client state change.
+ */
+void ZConfTrace::recordClientState(AvahiClientState const state)
+{
+    QMutexLocker lock(&recorderMutex);
+    if(!isRecording())
+    {
+        return;
+    }
+    writeRecordHeader(ZCONF_TRACE_CLIENT);
+    recorderStream << qint32(state);
+}
+
+/*!
+    Records a service browser event.
+ */
+void ZConfTrace::recordBrowserEvent(const ZConfBrowserEvent & event)
+{
+    QMutexLocker lock(&recorderMutex);
+    if(!isRecording())
+    {
+        return;
+    }
+    writeRecordHeader(ZCONF_TRACE_BROWSER);
+    writeString(recorderStream, event.source);
+    writeString(recorderStream, event.browsedDomain);
+    recorderStream << qint32(event.interface) << qint32(event.protocol) << qint32(event.event);
+    writeString(recorderStream, event.name);
+    writeString(recorderStream, event.type);
+    writeString(recorderStream, event.domain);
+    recorderStream << quint32(event.flags) << qint32(event.error);
+}
+
+/*!
+    Records a service resolver event.
+ */
+void ZConfTrace::recordResolverEvent(const ZConfResolverEvent & event)
+{
+    QMutexLocker lock(&recorderMutex);
+    if(!isRecording())
+    {
+        return;
+    }
+    writeRecordHeader(ZCONF_TRACE_RESOLVER);
+    writeString(recorderStream, event.source);
+    recorderStream << qint32(event.interface) << qint32(event.protocol) << qint32(event.event);
+    writeString(recorderStream, event.name);
+    writeString(recorderStream, event.type);
+    writeString(recorderStream, event.domain);
+    writeString(recorderStream, event.host);
+    writeString(recorderStream, event.address);
+    recorderStream << quint16(event.port) << event.TXTRecords << quint32(event.flags) << qint32(event.error);
+}
+
+/*!
+    Records an entry group state change.
+ */
+void ZConfTrace::recordEntryGroupEvent(const ZConfEntryGroupEvent & event)
+{
+    QMutexLocker lock(&recorderMutex);
+    if(!isRecording())
+    {
+        return;
+    }
+    writeRecordHeader(ZCONF_TRACE_ENTRY_GROUP);
+    writeString(recorderStream, event.name);
+    recorderStream << qint32(event.state) << qint32(event.error);
+}
+
+class ZConfTraceReplayPrivate
+{
+public:
+    ZConfTraceReplayPrivate(ZConfTraceReplay * const in_q)
+        : q(in_q)
+    {
+        timer.setSingleShot(true);
+        QObject::connect(&timer, &QTimer::timeout, [this]()
+        {
+            deliver();
+        });
+    }
+
+    bool read(QDataStream & stream)
+    {
+        quint32 magic   = 0;
+        quint16 version = 0;
+        stream >> magic >> version;
+        if(traceMagic != magic || traceVersion != version)
+        {
+            return false;
+        }
+
+        while(!stream.atEnd())
+        {
+            ZConfTraceRecord record = ZConfTraceRecord();
+            qint32  interface = 0, protocol = 0, event = 0, state = 0, error = 0;
+            quint32 flags = 0;
+            quint16 port  = 0;
+            stream >> record.kind >> record.time;
+            switch(record.kind)
+            {
+            case ZCONF_TRACE_CLIENT:
+                stream >> state;
+                record.clientState = (AvahiClientState) state;
+                break;
+            case ZCONF_TRACE_BROWSER:
+                record.browser.source        = readString(stream);
+                record.browser.browsedDomain = readString(stream);
+                stream >> interface >> protocol >> event;
+                record.browser.name   = readString(stream);
+                record.browser.type   = readString(stream);
+                record.browser.domain = readString(stream);
+                stream >> flags >> error;
+                record.browser.interface = (AvahiIfIndex) interface;
+                record.browser.protocol  = (AvahiProtocol) protocol;
+                record.browser.event     = (AvahiBrowserEvent) event;
+                record.browser.flags     = (AvahiLookupResultFlags) flags;
+                record.browser.error     = error;
+                break;
+            case ZCONF_TRACE_RESOLVER:
+                record.resolver.source = readString(stream);
+                stream >> interface >> protocol >> event;
+                record.resolver.name    = readString(stream);
+                record.resolver.type    = readString(stream);
+                record.resolver.domain  = readString(stream);
+                record.resolver.host    = readString(stream);
+                record.resolver.address = readString(stream);
+                stream >> port >> record.resolver.TXTRecords >> flags >> error;
+                record.resolver.interface = (AvahiIfIndex) interface;
+                record.resolver.protocol  = (AvahiProtocol) protocol;
+                record.resolver.event     = (AvahiResolverEvent) event;
+                record.resolver.port      = port;
+                record.resolver.flags     = (AvahiLookupResultFlags) flags;
+                record.resolver.error     = error;
+                break;
+            case ZCONF_TRACE_ENTRY_GROUP:
+                record.group.name = readString(stream);
+                stream >> state >> error;
+                record.group.state = (AvahiEntryGroupState) state;
+                record.group.error = error;
+                break;
+            default:
+                return false;
+            }
+            if(QDataStream::Ok != stream.status())
+            {
+                return false;
+            }
+            records.append(record);
+        }
+        return true;
+    }
+
+    void emitRecord(const ZConfTraceRecord & record)
+    {
+        switch(record.kind)
+        {
+        case ZCONF_TRACE_CLIENT:
+            emit q->clientStateChanged(record.clientState);
+            break;
+        case ZCONF_TRACE_BROWSER:
+            emit q->browserEvent(record.browser);
+            break;
+        case ZCONF_TRACE_RESOLVER:
+            emit q->resolverEvent(record.resolver);
+            break;
+        case ZCONF_TRACE_ENTRY_GROUP:
+            emit q->entryGroupEvent(record.group);
+        }
+    }
+
+    // Delivers every event that is due. At maximum speed, events are
+    // delivered in batches so that the event loop keeps running in between.
+    void deliver()
+    {
+        const qint64 now   = clock.nsecsElapsed();
+        int          batch = 0;
+        while(running && next < records.size())
+        {
+            if(0 < speed && offset(next) > now)
+            {
+                break;
+            }
+            if(0 >= speed && 1024 <= batch++)
+            {
+                break;
+            }
+            emitRecord(records.at(next++));
+        }
+        schedule();
+    }
+
+    void schedule()
+    {
+        if(!running)
+        {
+            return;
+        }
+        if(records.size() <= next)
+        {
+            running = false;
+            emit q->finished();
+            return;
+        }
+        const qint64 wait = 0 < speed ? (offset(next) - clock.nsecsElapsed()) / 1000000 : 0;
+        timer.start(int(qMax<qint64>(0, wait)));
+    }
+
+    // Time at which the record is due, relative to the start of replay.
+    qint64 offset(int const index) const
+    {
+        return qint64((records.at(index).time - records.first().time) / speed);
+    }
+
+    ZConfTraceReplay        * const q;
+    QList<ZConfTraceRecord>         records;
+    QTimer                          timer;
+    QElapsedTimer                   clock;
+    qreal                           speed   = 1.0;
+    int                             next    = 0;
+    bool                            running = false;
+};
+
+/*!
+    \class ZConfTraceReplay
+
+    \brief Plays back a trace recorded with ZConfTrace, without an Avahi
+    daemon.
+
+    Load a trace with load() and attach the objects that should receive the
+    events, e.g. with ZConfServiceBrowser::replay() or ZConfService::replay().
+    start() then feeds the recorded events to them, either with the recorded
+    timing (optionally sped up) or as fast as possible. This makes discovery
+    storms captured in production reproducible for profiling and regression
+    benchmarks.
+ */
+
+/*!
+    Creates an empty replay driver.
+ */
+ZConfTraceReplay::ZConfTraceReplay(QObject * const parent)
+    : QObject(parent),
+      d_ptr(new ZConfTraceReplayPrivate(this))
+{ }
+
+/*!
+    Destroys the replay driver.
+ */
+ZConfTraceReplay::~ZConfTraceReplay()
+{
+    delete d_ptr;
+}
+
+/*!
+    Loads the trace in \a fileName, replacing any trace loaded before.
+    Returns false if the file cannot be read or is not a valid trace.
+ */
+bool ZConfTraceReplay::load(const QString & fileName)
+{
+    stop();
+    d_ptr->records.clear();
+    d_ptr->next = 0;
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << (QLatin1String("Cannot open trace file '") % fileName % QLatin1String("': ") % file.errorString());
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    if(!d_ptr->read(stream))
+    {
+        qDebug() << (QLatin1String("Invalid trace file '") % fileName % QLatin1String("'."));
+        d_ptr->records.clear();
+        return false;
+    }
+    return true;
+}
+
+/*!
+    Returns the number of events in the loaded trace.
+ */
+int ZConfTraceReplay::eventCount() const
+{
+    return d_ptr->records.size();
+}
+
+/*!
+    Starts replaying from the beginning of the trace. A \a speed of 1.0 keeps
+    the recorded timing, 2.0 plays twice as fast, and zero or a negative value
+    delivers the events as fast as possible. finished() is emitted after the
+    last event.
+ */
+void ZConfTraceReplay::start(qreal speed)
+{
+    d_ptr->timer.stop();
+    d_ptr->speed   = speed;
+    d_ptr->next    = 0;
+    d_ptr->running = true;
+    d_ptr->clock.start();
+    d_ptr->schedule();
+}
+
+/*!
+    Stops replaying.
+ */
+void ZConfTraceReplay::stop()
+{
+    d_ptr->running = false;
+    d_ptr->timer.stop();
+}
+
+/*!
+    Returns true while a replay is in progress.
+ */
+bool ZConfTraceReplay::isRunning() const
+{
+    return d_ptr->running;
+}
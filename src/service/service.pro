@@ -7,5 +7,7 @@ CONFIG    += link_pkgconfig
 PKGCONFIG += avahi-qt5 avahi-client
 
 INCLUDEPATH += $$PROJ_DIR/include/
-SOURCES     += zconfservice.cpp
-HEADERS     += $$PROJ_DIR/include/qtzeroconf/zconfservice.h
+SOURCES     += zconfservice.cpp \
+               zconftxtrecord.cpp
+HEADERS     += $$PROJ_DIR/include/qtzeroconf/zconfservice.h \
+               $$PROJ_DIR/include/qtzeroconf/zconftxtrecord.h
@@ -18,15 +18,23 @@
  */
 
 #include <QDebug>
+#include <QFutureInterface>
 #include <QStringBuilder>
+#include <QTimer>
+
+#include <algorithm>
+#include <net/if.h>
 
 #include <avahi-client/publish.h>
 
 #include <avahi-common/error.h>
 #include <avahi-common/alternative.h>
 
+#include "qtzeroconf/zconflocalregistry.h"
 #include "qtzeroconf/zconfserviceclient.h"
 #include "qtzeroconf/zconfservice.h"
+#include "qtzeroconf/zconftrace.h"
+#include "qtzeroconf/zconftxtrecord.h"
 
 class ZConfServicePrivate
 {
@@ -39,25 +47,89 @@ public:
         if(nullptr != userdata)
         {
             const ZConfService * const serviceGroup = static_cast<ZConfService *>(userdata);
-            switch (state)
+            const ZConfEntryGroupEvent event{serviceGroup->d_ptr->name,
+                                             state,
+                                             AVAHI_ENTRY_GROUP_FAILURE == state ? avahi_client_errno(serviceGroup->d_ptr->client->client) : 0};
+            if(ZConfTrace::isRecording())
             {
-            case AVAHI_ENTRY_GROUP_ESTABLISHED:
-                emit serviceGroup->entryGroupEstablished();
-                qDebug() << (QLatin1String("Service '") % serviceGroup->d_ptr->name % QLatin1String("' successfully establised."));
-                break;
-            case AVAHI_ENTRY_GROUP_COLLISION:
-                emit serviceGroup->entryGroupNameCollision();
-                break;
-            case AVAHI_ENTRY_GROUP_FAILURE:
-                emit serviceGroup->entryGroupFailure();
-                qDebug() << (QLatin1String("Entry group failure: ") % serviceGroup->errorString());
-                break;
-            case AVAHI_ENTRY_GROUP_UNCOMMITED:
-                qDebug() << QLatin1String("AVAHI_ENTRY_GROUP_UNCOMMITED");
+                ZConfTrace::recordEntryGroupEvent(event);
+            }
+            entryGroupEvent(serviceGroup, event);
+        }
+    }
+
+    static void entryGroupEvent(const ZConfService * const serviceGroup, const ZConfEntryGroupEvent & event)
+    {
+        switch (event.state)
+        {
+        case AVAHI_ENTRY_GROUP_ESTABLISHED:
+            emit serviceGroup->entryGroupEstablished();
+            qDebug() << (QLatin1String("Service '") % event.name % QLatin1String("' successfully establised."));
+            break;
+        case AVAHI_ENTRY_GROUP_COLLISION:
+            serviceGroup->d_ptr->withdrawLocally();
+            emit serviceGroup->entryGroupNameCollision();
+            break;
+        case AVAHI_ENTRY_GROUP_FAILURE:
+            serviceGroup->d_ptr->withdrawLocally();
+            emit serviceGroup->entryGroupFailure();
+            qDebug() << (QLatin1String("Entry group failure: ") % QString(avahi_strerror(event.error)));
+            break;
+        case AVAHI_ENTRY_GROUP_UNCOMMITED:
+            qDebug() << QLatin1String("AVAHI_ENTRY_GROUP_UNCOMMITED");
+            break;
+        case AVAHI_ENTRY_GROUP_REGISTERING:
+            qDebug() << QLatin1String("AVAHI_ENTRY_GROUP_REGISTERING");
+        } // end switch
+    }
+
+    // Makes the service visible to browsers of this process right away,
+    // see ZConfLocalRegistry.
+    void publishLocally(AvahiProtocol const protocol, const QStringMap & txtRecords)
+    {
+        // Publishing under the same name replaces the service in place.
+        if(publishedName != name || publishedType != type)
+        {
+            withdrawLocally();
+        }
+        const QString host = options.host.isEmpty()
+                           ? QString(avahi_client_get_host_name_fqdn(client->client))
+                           : options.host;
+        // The service is reachable at its own address record if it has one,
+        // on the loopback interface if it runs on this host, and at an
+        // address unknown to us otherwise.
+        QString address;
+        for(const ZConfAddressRecord & record : options.addresses)
+        {
+            if(record.host.isEmpty() || record.host == options.host)
+            {
+                address = record.address;
                 break;
-            case AVAHI_ENTRY_GROUP_REGISTERING:
-                qDebug() << QLatin1String("AVAHI_ENTRY_GROUP_REGISTERING");
-            } // end switch
+            }
+        }
+        if(address.isEmpty() && options.host.isEmpty())
+        {
+            address = (AVAHI_PROTO_INET6 == protocol) ? QLatin1String("::1") : QLatin1String("127.0.0.1");
+        }
+        ZConfLocalRegistry::instance()->publish({name,
+                                                 type,
+                                                 options.domain.isEmpty() ? QString(QLatin1String("local")) : options.domain,
+                                                 host,
+                                                 address,
+                                                 port,
+                                                 protocol,
+                                                 txtRecords});
+        publishedName = name;
+        publishedType = type;
+    }
+
+    void withdrawLocally()
+    {
+        if(!publishedName.isEmpty())
+        {
+            ZConfLocalRegistry::instance()->withdraw(publishedType, publishedName);
+            publishedName.clear();
+            publishedType.clear();
         }
     }
 
@@ -66,7 +138,13 @@ public:
     QString              name;
     in_port_t            port;
     QString              type;
+    AvahiProtocol        protocol = AVAHI_PROTO_UNSPEC;
     int                  error = 0;
+    ZConfPublishOptions  options;
+    ZConfPublishOptions  registered;    // options of the service in the group
+    QString              publishedName;
+    QString              publishedType;
+    QList<QFutureInterface<bool>> pending; // registerServiceAsync() results
 };
 
 /*!
@@ -92,6 +170,17 @@ ZConfService::ZConfService(QObject *const parent)
  */
 ZConfService::~ZConfService()
 {
+    // Outstanding registerServiceAsync() calls can no longer complete; fail
+    // them so that nobody waits on them forever.
+    for(QFutureInterface<bool> & promise : d_ptr->pending)
+    {
+        if(!promise.isFinished())
+        {
+            promise.reportResult(false);
+            promise.reportFinished();
+        }
+    }
+    d_ptr->withdrawLocally();
     if(nullptr != d_ptr->group)
     {
         avahi_entry_group_free(d_ptr->group);
@@ -114,6 +203,10 @@ bool ZConfService::isValid() const
  */
 QString ZConfService::errorString() const
 {
+    if(0 != d_ptr->error)
+    {
+        return avahi_strerror(d_ptr->error);
+    }
     if(nullptr == d_ptr->client->client)
     {
         return QLatin1String("No client!");
@@ -132,17 +225,128 @@ namespace
             default:         return AVAHI_PROTO_UNSPEC;
         }
     }
+
+    // Avahi rejects flags that do not apply to the kind of record being
+    // added, so services and addresses get different subsets.
+    static AvahiPublishFlags convertServiceFlags(ZConfPublishOptions::PublishFlags flags)
+    {
+        int avahiFlags = 0;
+        if(flags & ZConfPublishOptions::UseMulticast) avahiFlags |= AVAHI_PUBLISH_USE_MULTICAST;
+        if(flags & ZConfPublishOptions::UseWideArea)  avahiFlags |= AVAHI_PUBLISH_USE_WIDE_AREA;
+        if(flags & ZConfPublishOptions::NoCookie)     avahiFlags |= AVAHI_PUBLISH_NO_COOKIE;
+        return (AvahiPublishFlags) avahiFlags;
+    }
+
+    static AvahiPublishFlags convertAddressFlags(ZConfPublishOptions::PublishFlags flags)
+    {
+        int avahiFlags = 0;
+        if(flags & ZConfPublishOptions::UseMulticast) avahiFlags |= AVAHI_PUBLISH_USE_MULTICAST;
+        if(flags & ZConfPublishOptions::UseWideArea)  avahiFlags |= AVAHI_PUBLISH_USE_WIDE_AREA;
+        if(flags & ZConfPublishOptions::NoReverse)    avahiFlags |= AVAHI_PUBLISH_NO_REVERSE;
+        return (AvahiPublishFlags) avahiFlags;
+    }
+
+    // Updating the TXT data of a service accepts neither cookie nor reverse
+    // lookup flags.
+    static AvahiPublishFlags convertUpdateFlags(ZConfPublishOptions::PublishFlags flags)
+    {
+        int avahiFlags = 0;
+        if(flags & ZConfPublishOptions::UseMulticast) avahiFlags |= AVAHI_PUBLISH_USE_MULTICAST;
+        if(flags & ZConfPublishOptions::UseWideArea)  avahiFlags |= AVAHI_PUBLISH_USE_WIDE_AREA;
+        return (AvahiPublishFlags) avahiFlags;
+    }
+
+    static AvahiIfIndex convertInterface(int interface)
+    {
+        return 0 < interface ? (AvahiIfIndex) interface : AVAHI_IF_UNSPEC;
+    }
+}
+
+/*!
+    \struct ZConfPublishOptions
+
+    \brief Controls where and how ZConfService publishes a service.
+
+    By default a service is published on all interfaces, for the local host
+    name and in the default domain. On multi-homed hosts, \a interfaces
+    restricts the announcement to the listed interface indices; use
+    interfaceIndex() to look an index up by name. An index less than one
+    makes registerService() fail. \a host and \a addresses
+    let the service point at an explicit host name with its own address
+    records, each of which may be limited to one interface. \a flags selects
+    Avahi publish flags such as multicast-only publishing or suppressing
+    reverse (PTR) records for the address records.
+ */
+
+/*!
+    \struct ZConfAddressRecord
+
+    \brief An address record published along with a service. \a interface is
+    an interface index, or a value less than one for all interfaces. \a host
+    is the fully qualified host name (ZConfPublishOptions::host if empty, and
+    the local host name if that is empty too) and
+    \a address the textual IPv4 or IPv6 address.
+ */
+
+/*!
+    Returns the index of the network interface \a name (e.g. "eth0"), or -1
+    if there is no such interface.
+ */
+int ZConfPublishOptions::interfaceIndex(const QString & name)
+{
+    const unsigned int index = if_nametoindex(name.toLocal8Bit().data());
+    return 0 == index ? -1 : (int) index;
+}
+
+/*!
+    Sets the options used by subsequent calls to registerService(). A service
+    that is already registered is not affected until it is registered again.
+ */
+void ZConfService::setPublishOptions(const ZConfPublishOptions & options)
+{
+    d_ptr->options = options;
+}
+
+/*!
+    Returns the options used to publish services.
+ */
+const ZConfPublishOptions & ZConfService::publishOptions() const
+{
+    return d_ptr->options;
 }
 /*!
     Registers a Zeroconf service on the LAN. If no service type is specified,
     "_http._tcp" is assumed. Needless to say, the server should be available
-    and listen on the specified port.
+    and listen on the specified port. If any of \a txtRecords is not a valid
+    TXT string, nothing is published and isValid() returns false.
  */
 void ZConfService::registerService(const QString &name,
                                    in_port_t const port,
                                    const QString &type,
                                    const Protocol protocol,
                                    const QStringMap &txtRecords)
+{
+    const ZConfTxtRecord txt(txtRecords);
+    if(txt.count() != txtRecords.size())
+    {
+        // Publishing the remaining pairs would silently drop data.
+        qDebug() << QLatin1String("ZConfService error: Invalid TXT record.");
+        d_ptr->error = AVAHI_ERR_INVALID_RECORD;
+        return;
+    }
+    registerService(name, port, type, protocol, txt);
+}
+
+/*!
+    Registers a Zeroconf service on the LAN with the pre-encoded TXT record
+    \a txt. The record is passed to Avahi as is, so a record that is
+    published repeatedly is only encoded once.
+ */
+void ZConfService::registerService(const QString &name,
+                                   in_port_t const port,
+                                   const QString &type,
+                                   const Protocol protocol,
+                                   const ZConfTxtRecord &txt)
 {
     if(   (nullptr == d_ptr->client->client)
        || (AVAHI_CLIENT_S_RUNNING != avahi_client_get_state(d_ptr->client->client)))
@@ -151,10 +355,6 @@ void ZConfService::registerService(const QString &name,
         return;
     }
 
-    d_ptr->name = name;
-    d_ptr->port = port;
-    d_ptr->type = type;
-
     if(nullptr == d_ptr->group)
     {
         d_ptr->group = avahi_entry_group_new(d_ptr->client->client,
@@ -164,26 +364,70 @@ void ZConfService::registerService(const QString &name,
 
     if(avahi_entry_group_is_empty(d_ptr->group))
     {
-        AvahiStringList * avahiTXTRecords = nullptr;
-        for(const QString & key : txtRecords.uniqueKeys())
+        // A registered service keeps its name, type and protocol until it
+        // is reset, so that updateServiceTxt() addresses the right one.
+        d_ptr->name     = name;
+        d_ptr->port     = port;
+        d_ptr->type     = type;
+        d_ptr->protocol = convertProtocol(protocol);
+
+        const ZConfPublishOptions & options = d_ptr->options;
+        const QByteArray host   = options.host.toLocal8Bit();
+        const QByteArray domain = options.domain.toLocal8Bit();
+
+        // interfaceIndex() returns -1 for unknown names, which would
+        // otherwise publish the service on all interfaces.
+        for(int const interface : options.interfaces)
+        {
+            if(1 > interface)
+            {
+                qDebug() << (QLatin1String("ZConfService error: Invalid interface index ") % QString::number(interface) % QLatin1String("."));
+                d_ptr->error = AVAHI_ERR_INVALID_INTERFACE;
+                return;
+            }
+        }
+
+        QList<int> interfaces = options.interfaces;
+        if(interfaces.isEmpty())
         {
-            static const QLatin1Char equals('=');
-            avahiTXTRecords = avahi_string_list_add(avahiTXTRecords,
-                                                   (key % equals % txtRecords[key]).toLocal8Bit().data());
+            interfaces.append(-1);
         }
 
-        d_ptr->error = avahi_entry_group_add_service_strlst(d_ptr->group,
-                                                            AVAHI_IF_UNSPEC,
-                                                            convertProtocol(protocol),
-                                                            (AvahiPublishFlags) 0,
-                                                            d_ptr->name.toLocal8Bit().data(),
-                                                            d_ptr->type.toLocal8Bit().data(),
-                                                            nullptr,
-                                                            nullptr,
-                                                            d_ptr->port,
-                                                            avahiTXTRecords);
+        d_ptr->error = 0;
+        for(int i = 0; 0 == d_ptr->error && i < interfaces.size(); ++i)
+        {
+            d_ptr->error = avahi_entry_group_add_service_strlst(d_ptr->group,
+                                                                convertInterface(interfaces.at(i)),
+                                                                convertProtocol(protocol),
+                                                                convertServiceFlags(options.flags),
+                                                                d_ptr->name.toLocal8Bit().data(),
+                                                                d_ptr->type.toLocal8Bit().data(),
+                                                                domain.isEmpty() ? nullptr : domain.data(),
+                                                                host.isEmpty()   ? nullptr : host.data(),
+                                                                d_ptr->port,
+                                                                txt.stringList());
+        }
 
-        avahi_string_list_free(avahiTXTRecords);
+        for(int i = 0; 0 == d_ptr->error && i < options.addresses.size(); ++i)
+        {
+            const ZConfAddressRecord & record = options.addresses.at(i);
+            const QByteArray addressHost = !record.host.isEmpty() ? record.host.toLocal8Bit()
+                                         : !host.isEmpty()        ? host
+                                         : QByteArray(avahi_client_get_host_name_fqdn(d_ptr->client->client));
+            AvahiAddress address;
+            if(nullptr == avahi_address_parse(record.address.toLocal8Bit().data(), AVAHI_PROTO_UNSPEC, &address))
+            {
+                qDebug() << (QLatin1String("ZConfService error: Invalid address '") % record.address % QLatin1String("'."));
+                d_ptr->error = AVAHI_ERR_INVALID_ADDRESS;
+                break;
+            }
+            d_ptr->error = avahi_entry_group_add_address(d_ptr->group,
+                                                         convertInterface(record.interface),
+                                                         address.proto,
+                                                         convertAddressFlags(options.flags),
+                                                         addressHost.data(),
+                                                         &address);
+        }
 
         if(0 == d_ptr->error)
         {
@@ -193,8 +437,147 @@ void ZConfService::registerService(const QString &name,
         if(0 != d_ptr->error)
         {
             qDebug() << (QLatin1String("Error creating service: ") % errorString());
+            // Leave the group empty so that the service can be registered
+            // again.
+            avahi_entry_group_reset(d_ptr->group);
+        }
+        else
+        {
+            d_ptr->registered = options;
+            d_ptr->publishLocally(d_ptr->protocol, txt.toMap());
+        }
+    }
+}
+
+/*!
+    Replaces the TXT record of the registered service with \a txt, without
+    registering the service again. Returns false if no service is registered
+    or Avahi rejects the update.
+ */
+bool ZConfService::updateServiceTxt(const ZConfTxtRecord &txt)
+{
+    if(nullptr == d_ptr->group || avahi_entry_group_is_empty(d_ptr->group))
+    {
+        qDebug() << QLatin1String("ZConfService error: No service registered.");
+        return false;
+    }
+
+    // The service keeps the options it was registered with, whatever
+    // setPublishOptions() has been called with since.
+    const ZConfPublishOptions & options = d_ptr->registered;
+    const QByteArray domain = options.domain.toLocal8Bit();
+
+    QList<int> interfaces = options.interfaces;
+    if(interfaces.isEmpty())
+    {
+        interfaces.append(-1);
+    }
+
+    d_ptr->error = 0;
+    for(int i = 0; 0 == d_ptr->error && i < interfaces.size(); ++i)
+    {
+        d_ptr->error = avahi_entry_group_update_service_txt_strlst(d_ptr->group,
+                                                                   convertInterface(interfaces.at(i)),
+                                                                   d_ptr->protocol,
+                                                                   convertUpdateFlags(options.flags),
+                                                                   d_ptr->name.toLocal8Bit().data(),
+                                                                   d_ptr->type.toLocal8Bit().data(),
+                                                                   domain.isEmpty() ? nullptr : domain.data(),
+                                                                   txt.stringList());
+    }
+
+    if(0 != d_ptr->error)
+    {
+        qDebug() << (QLatin1String("Error updating TXT record: ") % errorString());
+        return false;
+    }
+    if(!d_ptr->publishedName.isEmpty())
+    {
+        ZConfLocalRegistry::instance()->update(d_ptr->publishedType, d_ptr->publishedName, txt.toMap());
+    }
+    return true;
+}
+
+/*!
+    Registers a Zeroconf service like registerService() and returns a future
+    that yields true once the service has been established on the network.
+    Unlike registerService(), this may be called before the Avahi client is
+    running; the registration is then deferred until it is. The future yields
+    false if the entry group fails, the name collides, or the service has not
+    been established within \a timeout milliseconds. A negative timeout waits
+    without limit. It also yields false if a service is already registered,
+    or if this object is destroyed before the registration completes.
+
+    The registration is driven by the event loop of the calling thread. Use a
+    QFutureWatcher, or zconfAwait() when no event loop is running.
+ */
+QFuture<bool> ZConfService::registerServiceAsync(const QString &name,
+                                                 in_port_t const port,
+                                                 const QString &type,
+                                                 const Protocol protocol,
+                                                 const QStringMap &txtRecords,
+                                                 int const timeout)
+{
+    QFutureInterface<bool> promise;
+    promise.reportStarted();
+    d_ptr->pending.erase(std::remove_if(d_ptr->pending.begin(), d_ptr->pending.end(),
+                                        [](const QFutureInterface<bool> & p) { return p.isFinished(); }),
+                         d_ptr->pending.end());
+    d_ptr->pending.append(promise);
+
+    // Deleting the context object drops every connection made on behalf of
+    // this registration.
+    QObject * const context = new QObject(this);
+    auto finish = [promise, context](bool const established) mutable
+    {
+        if(!promise.isFinished())
+        {
+            promise.reportResult(established);
+            promise.reportFinished();
+        }
+        context->deleteLater();
+    };
+    auto doRegister = [this, name, port, type, protocol, txtRecords, finish]() mutable
+    {
+        // registerService() leaves an already populated group untouched, so
+        // nothing this call asked for would be published.
+        if(   (nullptr != d_ptr->group)
+           && !avahi_entry_group_is_empty(d_ptr->group))
+        {
+            qDebug() << QLatin1String("Service already registered, call resetService() first");
+            finish(false);
+            return;
+        }
+        registerService(name, port, type, protocol, txtRecords);
+        if(!isValid())
+        {
+            finish(false);
         }
+        else if(AVAHI_ENTRY_GROUP_ESTABLISHED == avahi_entry_group_get_state(d_ptr->group))
+        {
+            finish(true);
+        }
+    };
+
+    connect(this, &ZConfService::entryGroupEstablished,   context, [finish]() mutable { finish(true);  });
+    connect(this, &ZConfService::entryGroupFailure,       context, [finish]() mutable { finish(false); });
+    connect(this, &ZConfService::entryGroupNameCollision, context, [finish]() mutable { finish(false); });
+    connect(d_ptr->client, &ZConfServiceClient::clientFailure, context, [finish]() mutable { finish(false); });
+    if(0 <= timeout)
+    {
+        QTimer::singleShot(timeout, context, [finish]() mutable { finish(false); });
+    }
+
+    if(   (nullptr != d_ptr->client->client)
+       && (AVAHI_CLIENT_S_RUNNING == avahi_client_get_state(d_ptr->client->client)))
+    {
+        doRegister();
+    }
+    else
+    {
+        connect(d_ptr->client, &ZConfServiceClient::clientRunning, context, doRegister);
     }
+    return promise.future();
 }
 
 /*!
@@ -203,5 +586,28 @@ void ZConfService::registerService(const QString &name,
  */
 void ZConfService::resetService()
 {
+    d_ptr->withdrawLocally();
     avahi_entry_group_reset(d_ptr->group);
 }
+
+/*!
+    Feeds the entry group state changes recorded in \a trace for the service
+    \a name to this object, which then emits its signals as it would for the
+    live daemon. The recorded client state changes are passed to the
+    service's client, so that e.g. registerServiceAsync() sees a client
+    failure. This does not register anything on the network.
+ */
+void ZConfService::replay(ZConfTraceReplay * trace, const QString & name)
+{
+    connect(trace, &ZConfTraceReplay::entryGroupEvent, this, [this, name](const ZConfEntryGroupEvent & event)
+    {
+        if(name == event.name)
+        {
+            ZConfServicePrivate::entryGroupEvent(this, event);
+        }
+    });
+    connect(trace, &ZConfTraceReplay::clientStateChanged, this, [this](AvahiClientState state)
+    {
+        d_ptr->client->stateChanged(state);
+    });
+}
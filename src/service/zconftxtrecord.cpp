@@ -0,0 +1,251 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <QDebug>
+#include <QSharedData>
+#include <QStringBuilder>
+
+#include "qtzeroconf/zconftxtrecord.h"
+
+class ZConfTxtRecordData : public QSharedData
+{
+public:
+    ZConfTxtRecordData()
+    { }
+
+    ZConfTxtRecordData(const ZConfTxtRecordData & other)
+        : QSharedData(other)
+        , list(avahi_string_list_copy(other.list))
+        , count(other.count)
+        , size(other.size)
+    { }
+
+    ~ZConfTxtRecordData()
+    {
+        avahi_string_list_free(list);
+    }
+
+    // Adds a string of the form "key" or "key=value". The string is checked
+    // against the limits of RFC 6763 before it is encoded.
+    bool add(const QByteArray & key, const QByteArray * const value)
+    {
+        if(!ZConfTxtRecord::isValidKey(key))
+        {
+            qDebug() << (QLatin1String("Invalid TXT record key '") % QString::fromLocal8Bit(key) % QLatin1String("'."));
+            return false;
+        }
+        const int length = key.size() + (nullptr == value ? 0 : 1 + value->size());
+        if(ZConfTxtRecord::MaxStringSize < length)
+        {
+            qDebug() << (QLatin1String("TXT record '") % QString::fromLocal8Bit(key) % QLatin1String("' exceeds 255 bytes."));
+            return false;
+        }
+        if(nullptr != avahi_string_list_find(list, key.constData()))
+        {
+            qDebug() << (QLatin1String("Duplicate TXT record key '") % QString::fromLocal8Bit(key) % QLatin1String("'."));
+            return false;
+        }
+
+        AvahiStringList * const added = nullptr == value
+            ? avahi_string_list_add_pair_arbitrary(list, key.constData(), nullptr, 0)
+            : avahi_string_list_add_pair_arbitrary(list,
+                                                   key.constData(),
+                                                   reinterpret_cast<const uint8_t *>(value->constData()),
+                                                   size_t(value->size()));
+        if(nullptr == added)
+        {
+            return false;
+        }
+        list = added;
+        ++count;
+        size += 1 + length;
+        return true;
+    }
+
+    AvahiStringList * list  = nullptr;
+    int               count = 0;
+    int               size  = 0;
+};
+
+/*!
+    \class ZConfTxtRecord
+
+    \brief Pre-encoded DNS-SD TXT record data for ZConfService.
+
+    The record is encoded once, as it is built, and can then be passed to
+    ZConfService::registerService() and ZConfService::updateServiceTxt() as
+    often as needed without being encoded again. Keys and values are bytes:
+    values may contain binary data, and addFlag() adds a key without a value,
+    which RFC 6763 uses for boolean attributes.
+
+    Each key-value string is limited to 255 bytes. Keys must be non-empty,
+    printable US-ASCII and must not contain '='; a key can only be added
+    once. ZConfTxtRecord is implicitly shared.
+ */
+
+/*!
+    Creates an empty TXT record.
+ */
+ZConfTxtRecord::ZConfTxtRecord()
+    : d(new ZConfTxtRecordData)
+{ }
+
+/*!
+    Creates a TXT record from the key-value pairs in \a records. Pairs that
+    are not valid TXT strings are skipped; compare count() with the size of
+    \a records to detect this.
+ */
+ZConfTxtRecord::ZConfTxtRecord(const QStringMap & records)
+    : d(new ZConfTxtRecordData)
+{
+    for(QStringMap::const_iterator it = records.constBegin(); it != records.constEnd(); ++it)
+    {
+        const QByteArray value = it.value().toLocal8Bit();
+        d->add(it.key().toLocal8Bit(), &value);
+    }
+}
+
+ZConfTxtRecord::ZConfTxtRecord(const ZConfTxtRecord & other)
+    : d(other.d)
+{ }
+
+ZConfTxtRecord & ZConfTxtRecord::operator=(const ZConfTxtRecord & other)
+{
+    d = other.d;
+    return *this;
+}
+
+ZConfTxtRecord::~ZConfTxtRecord()
+{ }
+
+/*!
+    Adds the string "key=value". Returns false if the key is invalid or
+    already present, or if the string would exceed 255 bytes.
+ */
+bool ZConfTxtRecord::add(const QByteArray & key, const QByteArray & value)
+{
+    return d->add(key, &value);
+}
+
+/*!
+    Adds \a key without a value, i.e. the string "key". Returns false if the
+    key is invalid or already present.
+ */
+bool ZConfTxtRecord::addFlag(const QByteArray & key)
+{
+    return d->add(key, nullptr);
+}
+
+/*!
+    Returns true if the record contains \a key, with or without a value.
+ */
+bool ZConfTxtRecord::contains(const QByteArray & key) const
+{
+    return nullptr != avahi_string_list_find(d->list, key.constData());
+}
+
+/*!
+    Removes all strings from the record.
+ */
+void ZConfTxtRecord::clear()
+{
+    d = new ZConfTxtRecordData;
+}
+
+/*!
+    Returns true if the record contains no strings.
+ */
+bool ZConfTxtRecord::isEmpty() const
+{
+    return 0 == d->count;
+}
+
+/*!
+    Returns the number of strings in the record.
+ */
+int ZConfTxtRecord::count() const
+{
+    return d->count;
+}
+
+/*!
+    Returns the size of the record on the wire in bytes, i.e. the strings
+    plus one length byte each. RFC 6763 recommends keeping this below 1300
+    bytes, so that the record fits into a single packet.
+ */
+int ZConfTxtRecord::size() const
+{
+    return d->size;
+}
+
+/*!
+    Returns the strings of the record in the order they were added.
+ */
+QList<QByteArray> ZConfTxtRecord::strings() const
+{
+    QList<QByteArray> strings;
+    for(const AvahiStringList * txt = d->list; nullptr != txt; txt = txt->next)
+    {
+        // Avahi adds new strings at the front of the list.
+        strings.prepend(QByteArray(reinterpret_cast<const char *>(txt->text), int(txt->size)));
+    }
+    return strings;
+}
+
+/*!
+    Returns the record as a map of keys to values, decoded from the local
+    8-bit encoding. Flag keys map to an empty string.
+ */
+QStringMap ZConfTxtRecord::toMap() const
+{
+    QStringMap map;
+    for(const AvahiStringList * txt = d->list; nullptr != txt; txt = txt->next)
+    {
+        const QString string = QString::fromLocal8Bit(reinterpret_cast<const char *>(txt->text), int(txt->size));
+        const int     equals = string.indexOf(QLatin1Char('='));
+        map.insert(0 > equals ? string : string.left(equals),
+                   0 > equals ? QString() : string.mid(equals + 1));
+    }
+    return map;
+}
+
+/*!
+    Returns true if \a key is a valid TXT record key: non-empty, printable
+    US-ASCII and without '='.
+ */
+bool ZConfTxtRecord::isValidKey(const QByteArray & key)
+{
+    if(key.isEmpty() || MaxStringSize < key.size())
+    {
+        return false;
+    }
+    for(const char c : key)
+    {
+        if(c < 0x20 || c > 0x7e || '=' == c)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+AvahiStringList * ZConfTxtRecord::stringList() const
+{
+    return d->list;
+}
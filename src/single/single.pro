@@ -0,0 +1,20 @@
+include(../../project_settings.pri)
+TARGET     = qtzeroconf
+TEMPLATE   = lib
+CONFIG    += link_pkgconfig
+PKGCONFIG += avahi-qt5 avahi-client
+
+include(../../zconf.pri)
+
+qtHaveModule(widgets) {
+    QT      += widgets
+    SOURCES += $$PROJ_DIR/src/widget/zconfbrowserwidget.cpp
+    HEADERS += $$PROJ_DIR/include/qtzeroconf/zconfbrowserwidget.h
+
+    ZCONF_PC_WIDGETS = ", Qt5Widgets"
+}
+
+# The library only depends on Qt Widgets if the widget is built into it.
+pkgconfig.input    = $$PROJ_DIR/pkgconfig/qtzeroconf.pc.in
+pkgconfig.output   = $$DESTDIR/qtzeroconf.pc
+QMAKE_SUBSTITUTES += pkgconfig
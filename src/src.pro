@@ -1,8 +1,22 @@
 TEMPLATE = subdirs
 
-SUBDIRS = common \
-          browser \
-          service
+zconf_single {
+    SUBDIRS       = single \
+                    bench
+    bench.depends = single
+} else {
+    SUBDIRS = common \
+              browser \
+              service
 
-browser.depends = common
-service.depends = common
+    browser.depends = common
+    service.depends = common
+
+    SUBDIRS       += bench
+    bench.depends  = browser
+
+    qtHaveModule(widgets) {
+        SUBDIRS       += widget
+        widget.depends = browser
+    }
+}
@@ -1,7 +1,12 @@
-include(project_settings.pri)
-TARGET     = qtzeroconf
+include(../../project_settings.pri)
+DEPENDENCY_LIBRARIES = qtzeroconf-browser qtzeroconf-common
+include(../../dependency.pri)
+TARGET     = qtzeroconf-widget
 TEMPLATE   = lib
+QT        += widgets
 CONFIG    += link_pkgconfig
 PKGCONFIG += avahi-qt5 avahi-client
 
-INCLUDEPATH += include/
+INCLUDEPATH += $$PROJ_DIR/include/
+SOURCES     += zconfbrowserwidget.cpp
+HEADERS     += $$PROJ_DIR/include/qtzeroconf/zconfbrowserwidget.h
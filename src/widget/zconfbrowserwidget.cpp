@@ -18,26 +18,311 @@
  */
 
 #include <QDebug>
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QItemSelection>
+#include <QItemSelectionModel>
+#include <QSet>
+#include <QSortFilterProxyModel>
+#include <QStringBuilder>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
 #include "qtzeroconf/zconfbrowserwidget.h"
 #include "qtzeroconf/zconfservicebrowser.h"
 
+namespace
+{
+    enum Column { ServiceColumn, DomainColumn, HostColumn, ProtocolColumn, IpColumn, PortColumn, ColumnCount };
+
+    // Above this many removals in one batch, the model is rebuilt instead of
+    // removing the rows one by one. The view keeps its selection and scroll
+    // position across the rebuild.
+    const int maxRowRemovals = 64;
+
+    // Above this many rows changing visibility, a new filter text is applied
+    // to all rows at once instead of row by row.
+    const int maxFilterChanges = 256;
+
+    // Pending changes are applied at most once per frame.
+    const int frameInterval = 16;
+
+    struct ZConfServiceRow
+    {
+        QString           name;
+        ZConfServiceEntry entry;
+        QString           search;   // Lower case text matched by the filter.
+        mutable int       match;    // Result of the last filter pass, -1 if unknown.
+    };
+
+    QString searchText(const QString &name, const ZConfServiceEntry &entry)
+    {
+        QString text = name % QLatin1Char('\n') % entry.domain % QLatin1Char('\n') % entry.host
+                     % QLatin1Char('\n') % entry.ip % QLatin1Char('\n') % QString::number(entry.port);
+        for (QStringMap::const_iterator it = entry.TXTRecords.constBegin(); it != entry.TXTRecords.constEnd(); ++it)
+            text += QLatin1Char('\n') % it.key() % QLatin1Char('=') % it.value();
+        return text.toLower();
+    }
+}
+
+class ZConfServiceModel : public QAbstractTableModel
+{
+public:
+    explicit ZConfServiceModel(QObject *parent)
+        : QAbstractTableModel(parent)
+    { }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const
+    {
+        return parent.isValid() ? 0 : rows.size();
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const
+    {
+        return parent.isValid() ? 0 : ColumnCount;
+    }
+
+    QVariant data(const QModelIndex &index, int role) const
+    {
+        if (!index.isValid() || index.row() >= rows.size())
+            return QVariant();
+        const ZConfServiceRow &row = rows.at(index.row());
+        if (Qt::ToolTipRole == role) {
+            QStringList txt;
+            for (QStringMap::const_iterator it = row.entry.TXTRecords.constBegin(); it != row.entry.TXTRecords.constEnd(); ++it)
+                txt << (it.key() % QLatin1Char('=') % it.value());
+            return txt.join(QLatin1Char('\n'));
+        }
+        if (Qt::DisplayRole != role)
+            return QVariant();
+        switch (index.column()) {
+        case ServiceColumn:  return row.name;
+        case DomainColumn:   return row.entry.domain;
+        case HostColumn:     return row.entry.host;
+        case ProtocolColumn: return row.entry.protocolName();
+        case IpColumn:       return row.entry.ip;
+        case PortColumn:     return int(row.entry.port);   // Sorted numerically.
+        }
+        return QVariant();
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const
+    {
+        if (Qt::Horizontal != orientation || Qt::DisplayRole != role)
+            return QVariant();
+        switch (section) {
+        case ServiceColumn:  return QObject::tr("Service");
+        case DomainColumn:   return QObject::tr("Domain");
+        case HostColumn:     return QObject::tr("Host");
+        case ProtocolColumn: return QObject::tr("Protocol");
+        case IpColumn:       return QObject::tr("IP");
+        case PortColumn:     return QObject::tr("Port");
+        }
+        return QVariant();
+    }
+
+    const ZConfServiceRow &row(int i) const
+    {
+        return rows.at(i);
+    }
+
+    int rowOfService(const QString &name) const
+    {
+        return rowOf.value(name, -1);
+    }
+
+    // Tells the proxy that rows first to last need to be filtered again.
+    void rowsChanged(int first, int last)
+    {
+        emit dataChanged(createIndex(first, 0), createIndex(last, ColumnCount - 1));
+    }
+
+    void clear()
+    {
+        beginResetModel();
+        rows.clear();
+        rowOf.clear();
+        endResetModel();
+    }
+
+    // Brings the rows of the given services in line with the browser's
+    // entry table.
+    void apply(const ZConfServiceBrowser *browser, const QSet<QString> &names)
+    {
+        QVector<ZConfServiceRow> added;
+        QSet<QString> removed;
+        foreach (const QString &name, names) {
+            const ZConfServiceEntry entry = browser->serviceEntry(name);
+            QHash<QString, int>::const_iterator it = rowOf.constFind(name);
+            if (!entry.isValid()) {
+                if (it != rowOf.constEnd())
+                    removed.insert(name);
+            } else if (it == rowOf.constEnd()) {
+                added.append({name, entry, searchText(name, entry), -1});
+            } else {
+                ZConfServiceRow &row = rows[*it];
+                row.entry  = entry;
+                row.search = searchText(name, entry);
+                row.match  = -1;
+                emit dataChanged(createIndex(*it, 0), createIndex(*it, ColumnCount - 1));
+            }
+        }
+
+        if (removed.size() > maxRowRemovals) {
+            beginResetModel();
+            QVector<ZConfServiceRow> kept;
+            kept.reserve(rows.size() - removed.size() + added.size());
+            foreach (const ZConfServiceRow &row, rows) {
+                if (!removed.contains(row.name))
+                    kept.append(row);
+            }
+            kept += added;
+            rows.swap(kept);
+            reindex();
+            endResetModel();
+            return;
+        }
+
+        // Rows are removed back to front in runs of adjacent rows, so that
+        // the indexes of the rows still to be removed stay valid.
+        if (!removed.isEmpty()) {
+            QVector<int> doomed;
+            doomed.reserve(removed.size());
+            foreach (const QString &name, removed)
+                doomed.append(rowOf.value(name));
+            std::sort(doomed.begin(), doomed.end());
+            int last = doomed.size() - 1;
+            while (last >= 0) {
+                int first = last;
+                while (first > 0 && doomed.at(first - 1) == doomed.at(first) - 1)
+                    first--;
+                beginRemoveRows(QModelIndex(), doomed.at(first), doomed.at(last));
+                rows.erase(rows.begin() + doomed.at(first), rows.begin() + doomed.at(last) + 1);
+                endRemoveRows();
+                last = first - 1;
+            }
+            reindex();
+        }
+
+        if (!added.isEmpty()) {
+            beginInsertRows(QModelIndex(), rows.size(), rows.size() + added.size() - 1);
+            foreach (const ZConfServiceRow &row, added) {
+                rowOf.insert(row.name, rows.size());
+                rows.append(row);
+            }
+            endInsertRows();
+        }
+    }
+
+private:
+    void reindex()
+    {
+        rowOf.clear();
+        rowOf.reserve(rows.size());
+        for (int i = 0; i < rows.size(); i++)
+            rowOf.insert(rows.at(i).name, i);
+    }
+
+    QVector<ZConfServiceRow> rows;
+    QHash<QString, int>      rowOf;
+};
+
+// Filters on the rows' precomputed search text. A new filter text is
+// matched against the rows up front, and only the rows whose visibility
+// changes are passed to the proxy, which then inserts or removes just those.
+// When the text is narrowed (the new text contains the old one), rejected
+// rows are not searched again; when it is widened, accepted rows are not.
+class ZConfServiceFilter : public QSortFilterProxyModel
+{
+public:
+    ZConfServiceFilter(ZConfServiceModel *source, QObject *parent)
+        : QSortFilterProxyModel(parent),
+          model(source)
+    {
+        setSourceModel(source);
+        setDynamicSortFilter(true);
+    }
+
+    void setFilterText(const QString &filterText)
+    {
+        const QString lower = filterText.toLower();
+        if (lower == filter)
+            return;
+        const bool narrowing = lower.contains(filter);
+        const bool widening  = filter.contains(lower);
+        filter = lower;
+
+        QVector<int> changed;
+        for (int i = 0; i < model->rowCount(); i++) {
+            const ZConfServiceRow &row = model->row(i);
+            const int previous = row.match;
+            if ((narrowing && 0 == previous) || (widening && 1 == previous))
+                continue;
+            // Rows the proxy has not filtered yet (-1) need no notification.
+            if (previous != matches(row) && -1 != previous)
+                changed.append(i);
+        }
+
+        if (changed.size() > maxFilterChanges) {
+            invalidateFilter();
+            return;
+        }
+        int first = 0;
+        while (first < changed.size()) {
+            int last = first;
+            while (last + 1 < changed.size() && changed.at(last + 1) == changed.at(last) + 1)
+                last++;
+            model->rowsChanged(changed.at(first), changed.at(last));
+            first = last + 1;
+        }
+    }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+    {
+        Q_UNUSED(sourceParent);
+        const ZConfServiceRow &row = model->row(sourceRow);
+        return -1 == row.match ? matches(row) : row.match;
+    }
+
+private:
+    int matches(const ZConfServiceRow &row) const
+    {
+        row.match = filter.isEmpty() || row.search.contains(filter) ? 1 : 0;
+        return row.match;
+    }
+
+    ZConfServiceModel *const model;
+    QString                  filter;
+};
+
 class ZConfBrowserWidgetPrivate
 {
 public:
     ZConfBrowserWidgetPrivate(ZConfBrowserWidget *widget)
         : q(widget),
-          browser(0)
+          browser(0),
+          model(new ZConfServiceModel(widget)),
+          filter(new ZConfServiceFilter(model, widget))
     {
-        q->setColumnCount(6);
-        QStringList headers;
-        q->setHeaderLabels(headers << QObject::tr("Service")
-                                   << QObject::tr("Domain")
-                                   << QObject::tr("Host")
-                                   << QObject::tr("Protocol")
-                                   << QObject::tr("IP")
-                                   << QObject::tr("Port"));
-
+        q->setModel(filter);
+        q->setRootIsDecorated(false);
+        q->setUniformRowHeights(true);
+        q->setSortingEnabled(true);
+        q->sortByColumn(ServiceColumn, Qt::AscendingOrder);
         q->setColumnWidth(0, 170);
+
+        timer.setSingleShot(true);
+        timer.setInterval(frameInterval);
+        QObject::connect(&timer, &QTimer::timeout, [this]() {
+            flush();
+        });
+        QObject::connect(filter, &QAbstractItemModel::modelAboutToBeReset, [this]() {
+            saveView();
+        });
+        QObject::connect(filter, &QAbstractItemModel::modelReset, [this]() {
+            restoreView();
+        });
     }
 
     void init(QString serviceType)
@@ -47,27 +332,101 @@ public:
         type = serviceType;
         QObject::connect(browser, SIGNAL(serviceEntryAdded(QString)), q, SLOT(addService(QString)));
         QObject::connect(browser, SIGNAL(serviceEntryRemoved(QString)), q, SLOT(removeService(QString)));
-        q->clear();
+        QObject::connect(browser, SIGNAL(serviceEntryUpdated(QString,ZConfServiceEntry::Fields)), q, SLOT(updateService(QString)));
+        pending.clear();
+        model->clear();
         browser->browse(type);
     }
 
+    // Changes are collected and applied on the next frame, so that a burst
+    // of announcements causes a single update of the view.
+    void schedule(const QString &service)
+    {
+        pending.insert(service);
+        schedule();
+    }
+
+    void schedule()
+    {
+        if (!timer.isActive())
+            timer.start();
+    }
+
+    void flush()
+    {
+        QSet<QString> names;
+        names.swap(pending);
+        model->apply(browser, names);
+        filter->setFilterText(filterText);
+    }
+
+    QModelIndex indexOf(const QString &service) const
+    {
+        const int row = model->rowOfService(service);
+        return row < 0 ? QModelIndex() : filter->mapFromSource(model->index(row, ServiceColumn));
+    }
+
+    // The view loses its selection, current item and scroll position when
+    // the model is reset; they are remembered by service name.
+    void saveView()
+    {
+        selected.clear();
+        foreach (const QModelIndex &index, q->selectionModel()->selectedRows(ServiceColumn))
+            selected.append(index.data().toString());
+        current = q->currentIndex().sibling(q->currentIndex().row(), ServiceColumn).data().toString();
+        top     = q->indexAt(QPoint(0, 0)).sibling(q->indexAt(QPoint(0, 0)).row(), ServiceColumn).data().toString();
+    }
+
+    void restoreView()
+    {
+        QItemSelection selection;
+        foreach (const QString &service, selected) {
+            const QModelIndex index = indexOf(service);
+            if (index.isValid())
+                selection.select(index, index);
+        }
+        q->selectionModel()->select(selection, QItemSelectionModel::Select | QItemSelectionModel::Rows);
+        const QModelIndex currentIndex = indexOf(current);
+        if (currentIndex.isValid())
+            q->selectionModel()->setCurrentIndex(currentIndex, QItemSelectionModel::NoUpdate);
+        const QModelIndex topIndex = indexOf(top);
+        if (topIndex.isValid())
+            q->scrollTo(topIndex, QAbstractItemView::PositionAtTop);
+        selected.clear();
+    }
+
     ZConfBrowserWidget  *const q;
     ZConfServiceBrowser *browser;
+    ZConfServiceModel   *const model;
+    ZConfServiceFilter  *const filter;
+    QSet<QString>        pending;
+    QTimer               timer;
     QString              type;
+    QString              filterText;
+    QStringList          selected;
+    QString              current;
+    QString              top;
 };
 
 /*!
     \class ZConfBrowserWidget
 
-    \brief QTreeWidget-based widget for browsing and displaying Zeroconf
+    \brief QTreeView-based widget for browsing and displaying Zeroconf
     services available on the local network.
+
+    Services are kept in a flat model, so the view only creates what is
+    visible and stays responsive with tens of thousands of services. Changes
+    reported by the browser are applied at most once per frame. The columns
+    can be sorted by clicking their headers, and setFilterText() shows only
+    the services whose name, domain, host, address, port or TXT records
+    contain a given text.
  */
 
 /*!
     Creates a ZConfBrowserWidget object using the provided service type.
  */
 ZConfBrowserWidget::ZConfBrowserWidget(QString serviceType, QWidget *parent)
-    : QTreeWidget(parent),
+    : QTreeView(parent),
       d_ptr(new ZConfBrowserWidgetPrivate(this))
 {
     d_ptr->init(serviceType);
@@ -77,7 +436,7 @@ ZConfBrowserWidget::ZConfBrowserWidget(QString serviceType, QWidget *parent)
     Convenience constructor that uses "_http._tcp" as service type.
  */
 ZConfBrowserWidget::ZConfBrowserWidget(QWidget *parent)
-    : QTreeWidget(parent),
+    : QTreeView(parent),
       d_ptr(new ZConfBrowserWidgetPrivate(this))
 {
     d_ptr->init("_http._tcp");
@@ -97,50 +456,39 @@ ZConfBrowserWidget::~ZConfBrowserWidget()
  */
 void ZConfBrowserWidget::setCondensed(bool enabled)
 {
-    for (int i = 3; i < 7; i++) setColumnHidden(i, enabled);
-    setRootIsDecorated(!enabled);
+    for (int i = ProtocolColumn; i < ColumnCount; i++) setColumnHidden(i, enabled);
+}
+
+/*!
+    Shows only the services whose name, domain, host, IP address, port or TXT
+    records contain \a text, ignoring case. An empty text shows all services.
+    Like other changes, the new filter is applied on the next frame.
+ */
+void ZConfBrowserWidget::setFilterText(const QString &text)
+{
+    d_ptr->filterText = text;
+    d_ptr->schedule();
+}
+
+/*!
+    Returns the current filter text.
+ */
+QString ZConfBrowserWidget::filterText() const
+{
+    return d_ptr->filterText;
 }
 
 void ZConfBrowserWidget::addService(QString service)
 {
-    QTreeWidgetItem *parent = 0;
-    for (int i = 0; i < topLevelItemCount(); i++) {
-        QTreeWidgetItem *item = topLevelItem(i);
-        if (service == item->text(0)) {
-            parent = item;
-            break;
-        }
-    }
-    ZConfServiceEntry serviceEntry = d_ptr->browser->serviceEntry(service);
-    if (!serviceEntry.isValid())
-        return;         // No service entry with that name found.
-    if (!parent) {
-        parent = new QTreeWidgetItem(this);
-        parent->setText(0, service);
-        parent->setText(1, serviceEntry.domain);
-        parent->setText(2, serviceEntry.host);
-        parent->setText(5, QString::number(serviceEntry.port));
-    }
-
-    QTreeWidgetItem *entry = new QTreeWidgetItem(parent);
-    entry->setText(0, service);
-    entry->setText(1, serviceEntry.domain);
-    entry->setText(3, serviceEntry.protocolName());
-    entry->setText(4, serviceEntry.ip);
-    entry->setText(5, QString::number(serviceEntry.port));
+    d_ptr->schedule(service);
 }
 
 void ZConfBrowserWidget::removeService(QString service)
 {
-    int count = topLevelItemCount();
-    int i = 0;
-    while (i < count) {
-        QTreeWidgetItem *item = topLevelItem(i);
-        if (service == item->text(0)) {
-            delete item;
-            --count;
-        } else {
-            ++i;
-        }
-    }
+    d_ptr->schedule(service);
+}
+
+void ZConfBrowserWidget::updateService(QString service)
+{
+    d_ptr->schedule(service);
 }
@@ -0,0 +1,18 @@
+include(../../project_settings.pri)
+zconf_single {
+    DEPENDENCY_LIBRARIES = qtzeroconf
+} else {
+    DEPENDENCY_LIBRARIES = qtzeroconf-browser qtzeroconf-common
+}
+include(../../dependency.pri)
+TARGET     = tst_zconfendpointprober
+TEMPLATE   = app
+QT        += network testlib
+CONFIG    += console testcase link_pkgconfig
+CONFIG    -= app_bundle
+PKGCONFIG += avahi-qt5 avahi-client
+DEFINES   -= ZCONF_LIBRARY
+
+INCLUDEPATH += $$PROJ_DIR/include/
+SOURCES     += tst_zconfendpointprober.cpp
+LIBS        += -lrt
@@ -0,0 +1,216 @@
+/*
+ *  This file is part of qtzeroconf. (c) 2012 Johannes Hilden
+ *  https://github.com/johanneshilden/qtzeroconf
+ *
+ *  qtzeroconf is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  qtzeroconf is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with qtzeroconf; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <QList>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QtTest>
+
+#include "qtzeroconf/zconfendpointprober.h"
+#include "qtzeroconf/zconfservicebrowser.h"
+#include "qtzeroconf/zconftrace.h"
+
+// The browser is fed through a trace replay, so no avahi-daemon is needed.
+// Its signals are emitted directly instead of loading a recorded trace.
+class TestZConfEndpointProber : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void upAndDown();
+    void failureThreshold();
+    void ranking();
+    void generation();
+
+private:
+    void announce(const QString & name, const QString & ip, uint16_t port);
+
+    // A probe whose results are given by the test.
+    ZConfProbe heldProbe();
+
+    ZConfTraceReplay         * trace   = nullptr;
+    ZConfServiceBrowser      * browser = nullptr;
+    QList<ZConfProbeCallback>  pending;
+    QStringList                names;
+    QList<ZConfServiceEntry>   probed;
+};
+
+static const QString serviceType = QLatin1String("_test._tcp");
+
+void TestZConfEndpointProber::init()
+{
+    trace   = new ZConfTraceReplay;
+    browser = new ZConfServiceBrowser;
+    browser->replay(trace, serviceType);
+    pending.clear();
+    names.clear();
+    probed.clear();
+}
+
+void TestZConfEndpointProber::cleanup()
+{
+    delete browser;
+    delete trace;
+}
+
+void TestZConfEndpointProber::announce(const QString & name, const QString & ip, uint16_t const port)
+{
+    const QString domain = QLatin1String("local");
+    emit trace->browserEvent({serviceType, QString(), 1, AVAHI_PROTO_INET, AVAHI_BROWSER_NEW,
+                              name, serviceType, domain, (AvahiLookupResultFlags) 0, 0});
+    emit trace->resolverEvent({serviceType, 1, AVAHI_PROTO_INET, AVAHI_RESOLVER_FOUND,
+                               name, serviceType, domain, QLatin1String("test.local"), ip, port,
+                               QList<QByteArray>(), (AvahiLookupResultFlags) 0, 0});
+}
+
+ZConfProbe TestZConfEndpointProber::heldProbe()
+{
+    return [this](const QString & name, const ZConfServiceEntry & entry, const ZConfProbeCallback & done)
+    {
+        names.append(name);
+        probed.append(entry);
+        pending.append(done);
+    };
+}
+
+void TestZConfEndpointProber::upAndDown()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    ZConfEndpointProber prober(browser);
+    prober.setProbeInterval(20);
+    QSignalSpy up(&prober, &ZConfEndpointProber::endpointUp);
+    QSignalSpy down(&prober, &ZConfEndpointProber::endpointDown);
+
+    announce(QLatin1String("a"), QLatin1String("127.0.0.1"), server.serverPort());
+    QTRY_COMPARE(up.count(), 1);
+    QCOMPARE(up.first().first().toString(), QString(QLatin1String("a")));
+    QCOMPARE(prober.health(QLatin1String("a")).state, ZConfEndpointHealth::ZCONF_UP);
+    QVERIFY(0 <= prober.health(QLatin1String("a")).rtt);
+
+    server.close();
+    QTRY_COMPARE(down.count(), 1);
+    QCOMPARE(prober.health(QLatin1String("a")).state, ZConfEndpointHealth::ZCONF_DOWN);
+    QVERIFY(prober.failureThreshold() <= prober.health(QLatin1String("a")).failures);
+    QVERIFY(prober.rankedEndpoints().isEmpty());
+}
+
+void TestZConfEndpointProber::failureThreshold()
+{
+    ZConfEndpointProber prober(browser);
+    prober.setProbe(heldProbe());
+    prober.setProbeInterval(1);
+    prober.setProbeTimeout(60000);
+    prober.setFailureThreshold(3);
+    QSignalSpy up(&prober, &ZConfEndpointProber::endpointUp);
+    QSignalSpy down(&prober, &ZConfEndpointProber::endpointDown);
+
+    announce(QLatin1String("a"), QLatin1String("10.0.0.1"), 80);
+    for(int failures = 1; failures < 3; ++failures)
+    {
+        QTRY_COMPARE(pending.size(), 1);
+        pending.takeFirst()(false);
+        QCOMPARE(prober.health(QLatin1String("a")).failures, failures);
+        QCOMPARE(prober.health(QLatin1String("a")).state, ZConfEndpointHealth::ZCONF_UNKNOWN);
+        QCOMPARE(down.count(), 0);
+    }
+
+    QTRY_COMPARE(pending.size(), 1);
+    pending.takeFirst()(false);
+    QCOMPARE(prober.health(QLatin1String("a")).state, ZConfEndpointHealth::ZCONF_DOWN);
+    QCOMPARE(down.count(), 1);
+
+    QTRY_COMPARE(pending.size(), 1);
+    pending.takeFirst()(true);
+    QCOMPARE(prober.health(QLatin1String("a")).state, ZConfEndpointHealth::ZCONF_UP);
+    QCOMPARE(prober.health(QLatin1String("a")).failures, 0);
+    QCOMPARE(up.count(), 1);
+}
+
+void TestZConfEndpointProber::ranking()
+{
+    ZConfEndpointProber prober(browser);
+    prober.setProbe(heldProbe());
+    prober.setProbeInterval(1);
+    prober.setProbeTimeout(60000);
+    prober.setSmoothing(0.5);
+
+    announce(QLatin1String("a"), QLatin1String("10.0.0.1"), 80);
+    announce(QLatin1String("b"), QLatin1String("10.0.0.2"), 80);
+    QCOMPARE(names, QStringList() << QLatin1String("a") << QLatin1String("b"));
+
+    // a answers right away, b after 100 ms.
+    const ZConfProbeCallback a1 = pending.at(0);
+    const ZConfProbeCallback b1 = pending.at(1);
+    a1(true);
+    QTest::qWait(100);
+    b1(true);
+    QCOMPARE(prober.rankedEndpoints(), QStringList() << QLatin1String("a") << QLatin1String("b"));
+
+    // Now a takes 300 ms and b answers right away; with a smoothing of 0.5
+    // a averages about 150 ms and b about 50 ms.
+    const qreal a = prober.health(QLatin1String("a")).rtt;
+    const qreal b = prober.health(QLatin1String("b")).rtt;
+    QTRY_VERIFY(names.lastIndexOf(QLatin1String("a")) > 0 && names.lastIndexOf(QLatin1String("b")) > 1);
+    const ZConfProbeCallback a2 = pending.at(names.lastIndexOf(QLatin1String("a")));
+    const ZConfProbeCallback b2 = pending.at(names.lastIndexOf(QLatin1String("b")));
+    b2(true);
+    QTest::qWait(300);
+    a2(true);
+
+    const ZConfEndpointHealth ha = prober.health(QLatin1String("a"));
+    const ZConfEndpointHealth hb = prober.health(QLatin1String("b"));
+    QVERIFY(qFuzzyCompare(ha.rtt, 0.5 * ha.lastRtt + 0.5 * a));
+    QVERIFY(qFuzzyCompare(hb.rtt, 0.5 * hb.lastRtt + 0.5 * b));
+    QCOMPARE(prober.rankedEndpoints(), QStringList() << QLatin1String("b") << QLatin1String("a"));
+}
+
+void TestZConfEndpointProber::generation()
+{
+    ZConfEndpointProber prober(browser);
+    prober.setProbe(heldProbe());
+    prober.setProbeTimeout(60000);
+    QSignalSpy up(&prober, &ZConfEndpointProber::endpointUp);
+
+    announce(QLatin1String("a"), QLatin1String("10.0.0.1"), 80);
+    QCOMPARE(pending.size(), 1);
+    const ZConfProbeCallback stale = pending.takeFirst();
+
+    // The service moves while its probe is running; the new address is
+    // probed right away and the old probe's result no longer counts.
+    announce(QLatin1String("a"), QLatin1String("10.0.0.2"), 80);
+    QCOMPARE(pending.size(), 1);
+    QCOMPARE(probed.last().ip, QString(QLatin1String("10.0.0.2")));
+
+    stale(true);
+    QCOMPARE(prober.health(QLatin1String("a")).state, ZConfEndpointHealth::ZCONF_UNKNOWN);
+    QCOMPARE(up.count(), 0);
+
+    pending.takeFirst()(true);
+    QCOMPARE(prober.health(QLatin1String("a")).state, ZConfEndpointHealth::ZCONF_UP);
+    QCOMPARE(up.count(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestZConfEndpointProber)
+
+#include "tst_zconfendpointprober.moc"
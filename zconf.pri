@@ -1,7 +1,28 @@
+# Sources included directly into an application are linked statically.
+!contains(DEFINES, ZCONF_LIBRARY): DEFINES += ZCONF_STATIC
+
 SOURCES += $$PWD/src/service/zconfservice.cpp \
+           $$PWD/src/service/zconftxtrecord.cpp \
            $$PWD/src/common/zconfserviceclient.cpp \
-           $$PWD/src/browser/zconfservicebrowser.cpp
+           $$PWD/src/common/zconflocalregistry.cpp \
+           $$PWD/src/common/zconftrace.cpp \
+           $$PWD/src/browser/zconfservicebrowser.cpp \
+           $$PWD/src/browser/zconfhostresolver.cpp \
+           $$PWD/src/browser/zconfrecordbrowser.cpp \
+           $$PWD/src/browser/zconfsharedcache.cpp \
+           $$PWD/src/browser/zconfendpointprober.cpp
 
-HEADERS += $$PWD/include/qtzeroconf/zconfservice.h \
+HEADERS += $$PWD/include/qtzeroconf/zconfglobal.h \
+           $$PWD/include/qtzeroconf/zconfservice.h \
+           $$PWD/include/qtzeroconf/zconftxtrecord.h \
            $$PWD/include/qtzeroconf/zconfserviceclient.h \
-           $$PWD/include/qtzeroconf/zconfservicebrowser.h
+           $$PWD/include/qtzeroconf/zconflocalregistry.h \
+           $$PWD/include/qtzeroconf/zconftrace.h \
+           $$PWD/include/qtzeroconf/zconfservicebrowser.h \
+           $$PWD/include/qtzeroconf/zconfhostresolver.h \
+           $$PWD/include/qtzeroconf/zconfrecordbrowser.h \
+           $$PWD/include/qtzeroconf/zconfsharedcache.h \
+           $$PWD/include/qtzeroconf/zconfendpointprober.h \
+           $$PWD/include/qtzeroconf/zconffuture.h
+
+LIBS += -lrt